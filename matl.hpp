@@ -5,6 +5,10 @@
 
 #include <string>
 #include <list>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
 
 #include "source/api.hpp"
 
@@ -14,17 +18,26 @@ const std::string language_version = "0.6";
 
 #define MATL_IMPLEMENTATION_INCLUDED
 
-#include <memory>
 #include <unordered_map>
-#include <vector>
-#include <algorithm>
+#include <unordered_set>
 #include <exception>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+
+//SSE2 is used to scan domains sources on x86 targets; DEFINE MATL_NO_SSE2 to always use the scalar loops
+#if !defined(MATL_NO_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MATL_SSE2
+#include <emmintrin.h>
+#endif
 
 #include "source/common/common.hpp"
 #include "source/common/string_traversion.hpp"
+#include "source/common/lexer.hpp"
 #include "source/common/heterogeneous_map.hpp"
 #include "source/common/counting_set.hpp"
 #include "source/common/types_and_operators.hpp"
+#include "source/common/names_scope.hpp"
 
 #include "source/version/types.hpp"
 #include "source/version/operators.hpp"
@@ -39,6 +52,8 @@ const data_type* texture_data_type = get_data_type({ "texture" });
 //if variable is in this map, do not put it's name into translated shader, but it's translation (string at key)
 using inlined_variables = std::unordered_map<const named_variable*, std::string>;
 
+#include "source/common/parameters_layout.hpp"
+
 #include "source/translator.hpp"
 
 #include "source/implementation/domain_data.hpp"
@@ -49,14 +64,41 @@ struct context_public_implementation
 {
 	heterogeneous_map<std::string, function_definition, hgm_string_solver> common_functions;
 
+	//outermost scope of the names, contains common functions; materials and libraries scopes are nested in it
+	names_scope common_names{ nullptr, false };
+
 	heterogeneous_map<std::string, std::shared_ptr<parsed_domain>, hgm_string_solver> domains;
 	heterogeneous_map<std::string, std::string, hgm_string_solver> domain_insertions;
 
 	heterogeneous_map<std::string, std::shared_ptr<parsed_library>, hgm_string_solver> libraries;
+
+	//guards libraries, since they can be loaded on demand while parsing materials
+	//recursive since loading library may require loading other libraries
+	std::recursive_mutex libraries_mutex;
+
+	//whether libraries functions bodies are parsed on their first use instead of when the library is parsed
+	bool lazy_libraries = false;
+
+	//whether materials variables are validated only when some property uses them
+	bool deferred_variables_validation = false;
+
+	//whether errors of the variables not used by any property are reported as warnings, used with deferred validation
+	bool unused_variables_warnings = false;
 	heterogeneous_map<std::string, matl::custom_using_case_callback*, hgm_string_solver> custom_using_handles;
 
 	matl::library_source_request* lsr = nullptr;
+	matl::library_source_view_request* lsvr = nullptr;
 	translator* _translator = nullptr;
+
+	//all languages the context can emit materials in, including the main one (_translator)
+	heterogeneous_map<std::string, translator*, hgm_string_solver> targets;
+
+	std::unordered_map<const unary_operator_definition*, uint32_t> unary_operators_costs;
+	std::unordered_map<const binary_operator_definition*, uint32_t> binary_operators_costs;
+	heterogeneous_map<std::string, uint32_t, hgm_string_solver> exposed_functions_costs;
+	uint32_t cost_budget = 0;
+
+	heterogeneous_map<std::string, matl::native_function*, hgm_string_solver> native_functions;
 };
 
 struct matl::context::implementation
@@ -74,15 +116,21 @@ void get_used_variables_recursive(const expression* exp, counting_set<named_vari
 	}
 }
 
-//same but for functions
-void get_used_functions_recursive(expression* exp, counting_set<function_instance*>& to_dump)
+//same but for functions; instances are inserted after all the instances they call
+//walked : variables already walked, so each variable is walked once even if many expressions use it
+void get_used_functions_recursive(const expression* exp, counting_set<function_instance*>& to_dump, std::unordered_set<const named_variable*>& walked)
 {
-	for (auto& func : exp->used_functions)
-		for (auto& f : func)
-			to_dump.insert(f);
+	for (auto& table : exp->used_functions)
+		for (auto& instance : table)
+		{
+			for (auto& callee : instance->called_instances)
+				to_dump.insert(callee);
+			to_dump.insert(instance);
+		}
 
-	for (auto& func : exp->used_variables)
-		get_used_functions_recursive(func->second.value, to_dump);
+	for (auto& var : exp->used_variables)
+		if (walked.insert(var).second)
+			get_used_functions_recursive(var->second.value, to_dump, walked);
 }
 
 #include "source/common/expressions_parsing.hpp"
@@ -90,47 +138,32 @@ void get_used_functions_recursive(expression* exp, counting_set<function_instanc
 namespace handles_common
 {
 	template<class state_class>
-	void func(const string_view& unique_name, const std::string& source, context_public_implementation& context, state_class& state, std::string& error);
+	void func(const string_view& unique_name, const tokenized_source& source, context_public_implementation& context, state_class& state, std::string& error);
 
 	template<class state_class>
-	void _return(const std::string& source, context_public_implementation& context, state_class& state, std::string& error);
+	void _return(const tokenized_source& source, context_public_implementation& context, state_class& state, std::string& error);
 }
 
-inline void is_name_unique(
-	const string_view& name, 
-	const variables_collection* variables,
-	const decltype(parsed_domain::symbols)* symbols,
-	const parameters_collection* parameters,
-	const function_collection* functions,
-	const context_public_implementation& context,
-	const libraries_collection* libraries,
-	std::string& error
-)
+inline void is_name_unique(const string_view& name, const names_scope& scope, std::string& error)
 {
 	throw_error(name == domain_exposed_access, "Cannot use name: " + domain_exposed_access + "; It is reserved keyword");
 
-	throw_error(variables != nullptr && variables->find(name) != variables->end(),
-		"Cannot use this name; Variable named: " + std::string(name) + " already exists");
-
-	throw_error(symbols != nullptr && symbols != &reinterpret_cast<parsed_domain*>(0x0)->symbols && symbols->find(name) != symbols->end(),
-		"Cannot use this name; Symbol named: " + std::string(name) + " already exists");
-
-	throw_error(parameters != nullptr && parameters->find(name) != parameters->end(),
-		"Cannot use this name; Parameter named: " + std::string(name) + " already exists");
-	
-	throw_error(functions->find(name) != functions->end(),
-		"Cannot use this name; Function named: " + std::string(name) + " already exists");
-
-	throw_error(context.common_functions.find(name) != context.common_functions.end(),
-		"Cannot use this name; Function named: " + std::string(name) + " already exists");
-
-	throw_error(libraries != nullptr && libraries->find(name) != libraries->end(),
-		 "Cannot use this name; Library named: " + std::string(name) + " already exists");
+	auto entity = scope.find_declared(name);
+	throw_error(entity != nullptr,
+		"Cannot use this name; " + std::string(entity->get_display_name()) + " named: " + std::string(name) + " already exists");
 };
 
 #include "source/implementation/domain_parsing.hpp"
 #include "source/implementation/library_parsing.hpp"
+#include "source/implementation/variables_reachability.hpp"
+#include "source/implementation/cost_estimation.hpp"
 #include "source/implementation/material_parsing.hpp"
+#include "source/implementation/materials_merging.hpp"
+#include "source/implementation/cpu_evaluation.hpp"
+#include "source/implementation/compiled_material.hpp"
+#include "source/implementation/compile_session.hpp"
+#include "source/implementation/dependencies_scanning.hpp"
+#include "source/implementation/mapped_file.hpp"
 
 std::string matl::get_language_version()
 {
@@ -155,6 +188,7 @@ matl::context* matl::create_context(std::string target_language)
 
 	auto c = new context;
 	c->impl->impl._translator = itr->second;
+	c->impl->impl.targets.insert({ itr->first, itr->second });
 	return c;
 }
 
@@ -252,8 +286,12 @@ matl::add_commonly_exposed_functions_raport matl::context::add_commonly_exposed_
 		);
 
 		for (auto& func : context_impl.common_functions)
+		{
 			for (auto& instance : func.second.instances)
 				instance.function = &func.second;
+
+			context_impl.common_names.declare(func.first, scope_entity::new_function(&func));
+		}
 	}
 		
 	
@@ -263,59 +301,120 @@ matl::add_commonly_exposed_functions_raport matl::context::add_commonly_exposed_
 void matl::context::set_library_source_request_callback(library_source_request handle)
 {
 	impl->impl.lsr = handle;
+	impl->impl.lsvr = nullptr;
+}
+
+void matl::context::set_library_source_view_request_callback(library_source_view_request handle)
+{
+	impl->impl.lsvr = handle;
+	impl->impl.lsr = nullptr;
+}
+
+bool matl::context::add_target_language(const std::string& target_language)
+{
+	auto itr = translators.find(target_language);
+	if (itr == translators.end())
+		return false;
+
+	impl->impl.targets.insert({ itr->first, itr->second });
+	return true;
+}
+
+void matl::context::set_lazy_libraries_parsing(bool lazy)
+{
+	impl->impl.lazy_libraries = lazy;
+}
+
+void matl::context::set_deferred_variables_validation(bool deferred, bool warnings)
+{
+	impl->impl.deferred_variables_validation = deferred;
+	impl->impl.unused_variables_warnings = warnings;
+}
+
+void matl::context::set_operator_cost(std::string operator_symbol, uint32_t cost)
+{
+	set_unary_operator_cost(operator_symbol, cost);
+	set_binary_operator_cost(operator_symbol, cost);
+}
+
+void matl::context::set_unary_operator_cost(std::string operator_symbol, uint32_t cost)
+{
+	auto operato = get_unary_operator(operator_symbol);
+	if (operato != nullptr)
+		impl->impl.unary_operators_costs[operato] = cost;
+}
+
+void matl::context::set_binary_operator_cost(std::string operator_symbol, uint32_t cost)
+{
+	auto operato = get_binary_operator(operator_symbol);
+	if (operato != nullptr)
+		impl->impl.binary_operators_costs[operato] = cost;
+}
+
+void matl::context::set_exposed_function_cost(std::string function_name, uint32_t cost)
+{
+	impl->impl.exposed_functions_costs.insert({ std::move(function_name), cost });
+}
+
+void matl::context::set_cost_budget(uint32_t budget)
+{
+	impl->impl.cost_budget = budget;
+}
+
+void matl::context::add_native_function(std::string function_name, matl::native_function* function)
+{
+	if (function == nullptr)
+		impl->impl.native_functions.remove(function_name);
+	else
+		impl->impl.native_functions.insert({ std::move(function_name), function });
 }
 
 template<class state_class>
-void handles_common::func(const string_view& unique_function_name, const std::string& source, context_public_implementation& context, state_class& state, std::string& error)
+void handles_common::func(const string_view& unique_function_name, const tokenized_source& source, context_public_implementation& context, state_class& state, std::string& error)
 {
 	throw_error(state.function_body, "Cannot declare function inside another function");
 
 	auto& iterator = state.iterator;
 
-	get_spaces(source, iterator); 
-	throw_error(is_at_source_end(source, iterator), "");
-	throw_error(source.at(iterator) != '(', "Expected (");
-
-	iterator++;
+	throw_error(!get_operator(source, iterator, "("), "Expected (");
 
 	std::vector<std::string> arguments;
 
 	while (true)
 	{
-		get_spaces(source, iterator);
-
-		if (source.at(iterator) == ')') break;
+		if (get_operator(source, iterator, ")")) break;
 
 		arguments.push_back(get_string_ref(source, iterator, error));
 		if (arguments.back() == "") error = "Expected argument name";
 		rethrow_error();
 
-		get_spaces(source, iterator);
-
-		if (source.at(iterator) == ')') break;
+		if (get_operator(source, iterator, ")")) break;
 
-		throw_error(source.at(iterator) != ',', "Expected comma");
-
-		iterator++;
+		throw_error(!get_operator(source, iterator, ","), "Expected comma");
 	}
 
-	iterator++;
-	get_spaces(source, iterator);
-
 	throw_error(!is_at_line_end(source, iterator), "Expected line end");
 
 	auto& func_def = state.functions.insert({ unique_function_name, function_definition{}})->second;
 	func_def.arguments = std::move(arguments);
 	func_def.function_name_ptr = &state.functions.recent().first;
 
+	state.names.declare(unique_function_name, scope_entity::new_function(&state.functions.recent()));
+
+	state.function_names.clear();
+	state.function_names.set_parent(&state.names);
+
 	for (auto& arg : func_def.arguments)
-		func_def.variables.insert({ arg, {} });
+	{
+		auto& var = *func_def.variables.insert({ arg, {} });
+		state.function_names.declare(arg, scope_entity::new_variable(&var));
+	}
 
 	state.function_body = true;
 }
 
 template<class state_class>
-void handles_common::_return(const std::string& source, context_public_implementation& context, state_class& state, std::string& error)
+void handles_common::_return(const tokenized_source& source, context_public_implementation& context, state_class& state, std::string& error)
 {
 	auto& iterator = state.iterator;
 	auto& func_def = state.functions.recent().second;
@@ -329,12 +428,10 @@ void handles_common::_return(const std::string& source, context_public_implement
 		iterator,
 		state.this_line_indentation_spaces,
 		state.line_counter,
-		&func_def.variables,
-		nullptr,
-		&state.functions,
-		&state.libraries,
+		&state.function_names,
 		context,
 		nullptr,
+		nullptr,
 		error
 	);
 	if (error != "") func_def.valid = false;
@@ -13,9 +13,15 @@ namespace matl
 		//Shader code in target language
 		std::list<std::string> sources;
 
+		//Language of the sources
+		std::string target_language;
+
 		//Parsing errors
 		std::list<std::string> errors;
 
+		//Errors of the variables not used by any property, see context::set_deferred_variables_validation
+		std::list<std::string> warnings;
+
 		struct parameter
 		{
 			std::string name;
@@ -32,10 +38,113 @@ namespace matl
 
 			std::list<float> numeric_default_value;
 			std::string		 texture_default_value;
+
+			//Byte offset of the parameter inside the parameters block
+			//-1 if parameter is not a part of the block (textures, or domain does not pack parameters)
+			uint32_t block_offset = -1;
 		};
 
 		//Parameters (directx constants, opengl uniforms ...) generated by material
 		std::list<parameter> parameters;
+
+		//Size of the parameters block in bytes, 0 if domain does not pack parameters into a block
+		uint32_t parameters_block_size = 0;
+
+		//Static cost estimate of a single source
+		struct stage_cost
+		{
+			//Amount of operators evaluated, by width of the result: [0] scalar/bool, [1] vector2, [2] vector3, [3] vector4
+			uint32_t operations[4] = { 0, 0, 0, 0 };
+
+			//Calls to functions exposed by the domain or the context
+			uint32_t exposed_functions_calls = 0;
+
+			//Accesses to texture parameters
+			uint32_t texture_accesses = 0;
+
+			//Amount of if cases
+			uint32_t conditionals = 0;
+
+			//Longest chain of nested matl functions calls
+			uint32_t functions_calls_depth = 0;
+
+			//Sum of the operators and exposed functions weights (see context::set_operator_cost)
+			uint32_t weighted_cost = 0;
+		};
+
+		//Cost estimate of each source, in the same order as sources
+		std::list<stage_cost> stages_costs;
+
+		//Whether weighted cost of any source exceeds the context's cost budget
+		bool over_budget = false;
+	};
+
+	struct merged_material
+	{
+		//Whether merging was successful and there are no errors
+		bool success = false;
+
+		//Shader code in target language
+		std::list<std::string> sources;
+
+		//Parsing errors, prefixed with the index of the material that caused them
+		std::list<std::string> errors;
+
+		struct material
+		{
+			//Value of the domain's parameters index symbol that selects this material
+			uint32_t id = 0;
+
+			//Parameters of this material; block_offset is relative to the material's element of the parameters buffer
+			//textures names are prefixed with m<id>_, since textures are not shared between merged materials
+			std::list<parsed_material::parameter> parameters;
+
+			//Estimated cost of the material; weighted cost of all of it's properties (see parsed_material::stage_cost)
+			uint32_t cost = 0;
+		};
+
+		//Merged materials, in the order of the given sources
+		std::list<material> materials;
+
+		//Stride of the parameters buffer element in bytes
+		uint32_t parameters_block_size = 0;
+
+		//Estimated cost of the merged program if all pixels of a draw use the same material (the most expensive material cost)
+		uint32_t coherent_cost = 0;
+
+		//Estimated cost of the merged program if materials are mixed within a draw (sum of the materials costs)
+		uint32_t divergent_cost = 0;
+	};
+
+	//Domain, libraries and custom using cases used by the material, see scan_dependencies
+	struct material_dependencies
+	{
+		struct dependency
+		{
+			//Name of the domain or library
+			std::string name;
+
+			//Line of the using
+			int line = 0;
+		};
+
+		//Domain used by the material; empty name if material does not specify it
+		dependency domain;
+
+		//Libraries used by the material
+		std::list<dependency> libraries;
+
+		struct custom_using
+		{
+			std::string _case;
+			std::string argument;
+
+			//Line of the using
+			int line = 0;
+		};
+
+		//Custom using cases used by the material, see context::add_custom_using_case_callback
+		std::list<custom_using> custom_usings;
 	};
 
 	struct domain_parsing_raport
@@ -68,17 +177,208 @@ namespace matl
 		std::list<std::string> errors;
 	};
 
+	//Non-owning range of characters, lets the sources be parsed in place without copying them into a std::string
+	//Characters must stay valid and unchanged until the function given the view returns
+	class source_view
+	{
+	public:
+		source_view() {};
+		source_view(const char* data, size_t size) : chars(data), length(size) {};
+		source_view(const std::string& source) : chars(source.data()), length(source.size()) {};
+
+		const char* data() const { return chars; }
+		size_t size() const { return length; }
+
+		//Characters past the end are read as '\0', the same as the end of a std::string
+		char operator[](size_t id) const { return id < length ? chars[id] : '\0'; }
+
+		const char& at(size_t id) const
+		{
+			if (id >= length) throw std::out_of_range("matl::source_view::at");
+			return chars[id];
+		}
+
+		std::string substr(size_t begin, size_t count) const
+		{
+			if (begin > length) throw std::out_of_range("matl::source_view::substr");
+			return std::string(chars + begin, std::min(count, length - begin));
+		}
+
+	private:
+		const char* chars = nullptr;
+		size_t length = 0;
+	};
+
+	//File mapped into the memory, so it can be parsed in place instead of being read into a std::string first
+	//The view is valid as long as the mapped_file exists; the file must not be modified meanwhile
+	class mapped_file
+	{
+	public:
+		mapped_file() {};
+		mapped_file(const std::string& path);
+		~mapped_file();
+
+		mapped_file(mapped_file&& other) noexcept;
+		mapped_file& operator=(mapped_file&& other) noexcept;
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		//Whether the file was opened and mapped successfully
+		bool is_open() const { return opened; }
+
+		//Content of the file; empty if the file is not open
+		source_view view() const { return opened ? source_view(data != nullptr ? data : "", size) : source_view(); }
+
+	private:
+		const char* data = nullptr;
+		size_t size = 0;
+		bool opened = false;
+
+		//handle of the file mapping object, used on windows only
+		void* mapping = nullptr;
+
+		void close();
+	};
+
 	using custom_using_case_callback = void(std::string args, std::string& error);
 	using library_source_request = const std::string* (const std::string& lib_name, std::string& error);
 
+	//Same as library_source_request, but returns a view of the source; view with no data (source_view()) if there is no such library
+	using library_source_view_request = source_view(const std::string& lib_name, std::string& error);
+
 	class context;
 
+	//Single call of a native function, evaluating it for a batch of values
+	//All values are stored as structure of arrays; each component points to count floats
+	struct native_call
+	{
+		//Components of all arguments, in order
+		const float* const* arguments;
+
+		//Amount of components of each argument; 1 for scalars, bools (0 or 1) and textures (index of the texture in cpu_property::parameters)
+		const uint8_t* arguments_sizes;
+		size_t arguments_count;
+
+		//Components of the returned value
+		float* const* results;
+		uint8_t results_size;
+
+		//Amount of values in the batch
+		size_t count;
+	};
+
+	//Cpu implementation of a function exposed by domain or context, see context::add_native_function
+	using native_function = void(const native_call& call);
+
+	//Material property compiled for evaluation on the cpu
+	class cpu_property
+	{
+	public:
+		//Whether compilation was successful and there are no errors
+		bool success = false;
+
+		//Parsing and compilation errors
+		std::list<std::string> errors;
+
+		struct input
+		{
+			std::string name;
+
+			//Amount of components; 1 for scalars and bools
+			uint8_t size;
+		};
+
+		//Domain symbols used by the property; their components are the inputs of evaluate, in this order
+		std::list<input> symbols;
+
+		//Parameters used by the property; set to their default values until changed with set_parameter
+		std::list<parsed_material::parameter> parameters;
+
+		//Amount of components of the property value
+		uint8_t size = 0;
+
+		//Changes value of the numeric parameter; returns false if there is no such parameter or the value has invalid size
+		bool set_parameter(const std::string& name, const std::list<float>& value);
+
+		//inputs : components of the symbols, in order of the symbols list; each points to count floats
+		//results : components of the property value; each points to count floats
+		void evaluate(const float* const* inputs, float* const* results, size_t count) const;
+
+	private:
+		struct implementation;
+		class compiler;
+		std::shared_ptr<const implementation> impl;
+		std::vector<float> parameters_values;
+
+		friend cpu_property compile_property(const std::string& material_source, const std::string& property_name, matl::context* context);
+	};
+
+	//Material parsed once, that can be emitted many times (eg. with different fallbacks or for different domains)
+	//Context used to compile the material must outlive it; emit is not thread safe
+	class compiled_material
+	{
+	public:
+		//Whether parsing was successful and there are no errors
+		bool success = false;
+
+		//Parsing errors
+		std::list<std::string> errors;
+
+		struct emit_options
+		{
+			//Properties that should be replaced with the domain's fallbacks (see parse_material_variants)
+			std::list<std::string> properties_fallbacks;
+
+			//Language to emit the material in, one of the context's target languages; empty to use the context's main language
+			std::string target_language;
+		};
+
+		//domain_override : name of the domain to emit the material for, empty to use the domain specified by the material
+		//Domain must be compatible with the material: every of it's properties has to be specified by the material with the same type,
+		//and symbols and functions used by it's properties (directly or through variables) must be exposed by it with the same types
+		parsed_material emit(const std::string& domain_override = "", const emit_options& options = {});
+
+	private:
+		struct implementation;
+		std::shared_ptr<implementation> impl;
+
+		friend compiled_material compile_material(const std::string& material_source, matl::context* context);
+	};
+
+	//Parses materials one after another, keeping it's parsing state, tokens and emission buffers between calls, which makes parsing many small materials cheaper
+	//Arrays and hash tables keep their memory; lists of the material's variables, parameters and functions are still allocated per material
+	//Context must outlive the session; session is not thread safe, use one per thread
+	class compile_session
+	{
+	public:
+		compile_session(matl::context* context);
+
+		//Same as matl::parse_material
+		parsed_material parse_material(const std::string& material_source);
+		parsed_material parse_material(const source_view& material_source);
+
+	private:
+		struct implementation;
+		std::shared_ptr<implementation> impl;
+	};
+
 	context* create_context(std::string target_language);
 	void destroy_context(context*);
 
 	parsed_material parse_material(const std::string& material_source, matl::context* context);
+	parsed_material parse_material(const source_view& material_source, matl::context* context);
+	std::list<parsed_material> parse_material_variants(const std::string& material_source, const std::list<std::list<std::string>>& variants_fallbacks, matl::context* context);
+	std::list<parsed_material> parse_material_targets(const std::string& material_source, matl::context* context);
+	parsed_material check_material(const std::string& material_source, matl::context* context);
+	material_dependencies scan_dependencies(const std::string& material_source);
+	material_dependencies scan_dependencies(const source_view& material_source);
+	merged_material merge_materials(const std::list<std::string>& materials_sources, matl::context* context);
+	cpu_property compile_property(const std::string& material_source, const std::string& property_name, matl::context* context);
+	compiled_material compile_material(const std::string& material_source, matl::context* context);
 	std::list<matl::library_parsing_raport> parse_library(const std::string library_name, const std::string& library_source, matl::context* context);
+	std::list<matl::library_parsing_raport> parse_library(const std::string library_name, const source_view& library_source, matl::context* context);
 	domain_parsing_raport parse_domain(const std::string domain_name, const std::string& domain_source, matl::context* context);
+	domain_parsing_raport parse_domain(const std::string domain_name, const source_view& domain_source, matl::context* context);
 }
 
 class matl::context
@@ -87,8 +387,18 @@ private:
 	struct implementation;
 	implementation* impl;
 	friend parsed_material matl::parse_material(const std::string& material_source, matl::context* context);
+	friend parsed_material matl::parse_material(const source_view& material_source, matl::context* context);
+	friend std::list<parsed_material> matl::parse_material_variants(const std::string& material_source, const std::list<std::list<std::string>>& variants_fallbacks, matl::context* context);
+	friend std::list<parsed_material> matl::parse_material_targets(const std::string& material_source, matl::context* context);
+	friend parsed_material matl::check_material(const std::string& material_source, matl::context* context);
+	friend merged_material matl::merge_materials(const std::list<std::string>& materials_sources, matl::context* context);
+	friend cpu_property matl::compile_property(const std::string& material_source, const std::string& property_name, matl::context* context);
+	friend compiled_material matl::compile_material(const std::string& material_source, matl::context* context);
+	friend class compile_session;
 	friend std::list<matl::library_parsing_raport> matl::parse_library(const std::string library_name, const std::string& library_source, matl::context* context);
+	friend std::list<matl::library_parsing_raport> matl::parse_library(const std::string library_name, const source_view& library_source, matl::context* context);
 	friend domain_parsing_raport matl::parse_domain(const std::string domain_name, const std::string& domain_source, matl::context* context);
+	friend domain_parsing_raport matl::parse_domain(const std::string domain_name, const source_view& domain_source, matl::context* context);
 
 public:
 	void add_domain_insertion(std::string name, std::string insertion);
@@ -96,6 +406,32 @@ public:
 	void add_custom_using_case_callback(std::string _case, custom_using_case_callback callback);
 	void set_library_source_request_callback(library_source_request handle);
 
+	//Same as set_library_source_request_callback, but the callback returns views of the sources, so they are not copied (eg. mapped files)
+	//Replaces the callback set by set_library_source_request_callback and vice versa
+	void set_library_source_view_request_callback(library_source_view_request handle);
+
+	//If enabled, functions bodies of libraries parsed later are parsed only when some material uses the function for the first time
+	void set_lazy_libraries_parsing(bool lazy);
+
+	//If enabled, material variables are validated only if any property uses them (directly or through other variables)
+	//warnings : whether errors of the unused variables should be still reported, as warnings (see parsed_material::warnings)
+	void set_deferred_variables_validation(bool deferred, bool warnings = false);
+
+	//Adds another language materials can be emitted in; returns false if there is no translator for such language
+	bool add_target_language(const std::string& target_language);
+
+	//Sets the weight of the unary and the binary operator of the symbol
+	void set_operator_cost(std::string operator_symbol, uint32_t cost);
+
+	//Same, but only for one of the operators of the symbol (eg. negation and subtraction for "-")
+	void set_unary_operator_cost(std::string operator_symbol, uint32_t cost);
+	void set_binary_operator_cost(std::string operator_symbol, uint32_t cost);
+
+	void set_exposed_function_cost(std::string function_name, uint32_t cost);
+	void set_cost_budget(uint32_t budget);
+
+	void add_native_function(std::string function_name, native_function* function);
+
 private:
 	context();
 	~context();
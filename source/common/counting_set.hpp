@@ -27,6 +27,12 @@ public:
 		return (*itr).second;
 	}
 
+	//removes all elements, but keeps the allocated memory
+	inline void clear()
+	{
+		elements.clear();
+	}
+
 	inline iterator begin()
 	{
 		return elements.begin();
@@ -2,101 +2,40 @@
 
 void instantiate_function(
 	function_definition& func_def,
-	const std::vector<const data_type*> arguments,
-	decltype(expression::used_functions)& used_functions,
+	std::vector<const data_type*> arguments,
+	std::string& error
+);
+
+void parse_lazy_function_body(
+	function_definition& func_def,
+	context_public_implementation& context,
 	std::string& error
 );
 
 namespace expressions_parsing_utilities
 {
-	inline string_view get_node_str(const std::string& source, size_t& iterator, std::string& error)
-	{
-		if (source.size() >= iterator + 1)
-		{
-			if ((
-				source.at(iterator) == '!' || source.at(iterator) == '>' || source.at(iterator) == '<' || source.at(iterator) == '='
-				)
-				&& source.at(iterator + 1) == '='
-				)
-			{
-				iterator += 2;
-				return string_view{ source, iterator - 2, iterator };
-			}
-		}
-
-		if (is_operator(source.at(iterator)))
-		{
-			iterator++;
-			return string_view{ source, iterator - 1, iterator };
-		}
-
-		size_t begin = iterator;
-
-		bool only_digits = true;
-		bool dot_used = false;
-
-		while (true)
-		{
-			const char& c = source.at(iterator);
-
-			if (!is_digit(c) && c != '.') only_digits = false;
-
-			if (is_operator(c))
-			{
-				if (c != '.') break;
-				if (!only_digits) break;
-				if (dot_used) break;
-				dot_used = true;
-			}
-
-			if (is_whitespace(c)) break;
-
-			iterator++; if (iterator == source.size()) break;
-		}
-
-		if (iterator == begin)
-		{
-			error = "Expected token not: ";
-
-			if (source.at(iterator) == ' ')
-				error += "space";
-			else if (source.at(iterator) == '\n')
-				error += "new line";
-			else if (source.at(iterator) == '\t')
-				error += "tab";
-			else
-				error += source.at(iterator);
-		}
-
-		return string_view{ source, begin, iterator };
-	}
-
-	inline bool is_function_call(const std::string& source, size_t& iterator)
+	//state of the expression validated while being parsed (see get_expression)
+	struct expression_typing
 	{
-		get_spaces(source, iterator);
+		std::vector<const data_type*> types;
+		decltype(expression::used_functions) used_functions = { {} };
 
-		if (is_at_line_end(source, iterator))
-			return false;
+		//type of the whole expression; all of its cases values must be of this type
+		const data_type* type = nullptr;
+	};
 
-		return (source.at(iterator) == '(');
-	}
+	inline void validate_node(
+		decltype(expression::used_functions)& used_functions,
+		expression::node* n,
+		std::vector<const data_type*>& types,
+		const std::shared_ptr<const parsed_domain>& domain,
+		std::string& error
+	);
 
-	inline bool is_scalar_literal(const string_view& node_str, std::string& error)
+	//whether the next token opens the call's arguments
+	inline bool is_function_call(const tokenized_source& source, size_t& iterator)
 	{
-		size_t dot_pos = -1;
-
-		for (size_t i = 0; i < node_str.size(); i++)
-		{
-			if (node_str.at(i) == '.' && dot_pos == -1)
-				dot_pos = i;
-			else if (!is_digit(node_str.at(i)))
-				return false;
-		}
-
-		if (dot_pos == 0 || dot_pos == node_str.size() - 1)
-			error = "Invalid scalar literal: " + std::string(node_str);
-
-		return true;
+		return is_operator_token(source, iterator, "(");
 	}
 
 	inline bool is_unary_operator(const string_view& node_str)
@@ -109,36 +48,6 @@ namespace expressions_parsing_utilities
 		return get_binary_operator(node_str) != nullptr;
 	}
 
-	inline int get_comas_inside_parenthesis(const std::string& source, size_t iterator, std::string& error)
-	{
-		int parenthesis_deepness = 0;
-		int comas = 0;
-
-		while (!is_at_line_end(source, iterator))
-		{
-			switch (source.at(iterator))
-			{
-			case '(':
-				parenthesis_deepness++; break;
-			case ')':
-				parenthesis_deepness--;
-				if (parenthesis_deepness == 0) goto _get_comas_inside_parenthesis_break;
-				break;
-			case ',':
-				if (parenthesis_deepness == 1)
-					comas++;
-				break;
-			}
-			iterator++;
-		}
-
-	_get_comas_inside_parenthesis_break:
-		if (parenthesis_deepness != 0)
-			error = "Mismatched parentheses";
-
-		return comas;
-	}
-
 	int get_precedence(const expression::node* node)
 	{
 		switch (node->get_type())
@@ -163,73 +72,92 @@ namespace expressions_parsing_utilities
 				node->get_type() == expression::node::node_type::function;
 	}
 
-	void insert_operator(
-		std::list<expression::node*>& operators_stack,
-		std::list<expression::node*>& output,
-		expression::node* node
-	)
-	{
-		while (operators_stack.size() != 0)
-		{
-			auto previous = operators_stack.back();
-			if (
-				previous->get_type() != expression::node::node_type::left_parenthesis &&
-				previous->get_type() != expression::node::node_type::vector_contructor_operator &&
-				previous->get_type() != expression::node::node_type::function &&
-				get_precedence(previous) >= get_precedence(node)
-				)
-			{
-				output.push_back(previous);
-				operators_stack.pop_back();
-			}
-			else break;
-		}
-
-		operators_stack.push_back(node);
-	};
-
 	void shunting_yard(
-		const std::string& source,
+		const tokenized_source& source,
 		size_t& iterator,
 		int indentation,
 		int& lines_counter,
-		variables_collection* variables,
-		parameters_collection* parameters,
-		function_collection* functions,
-		libraries_collection* libraries,
+		const names_scope* names,
 		const context_public_implementation& context_impl,
 		std::shared_ptr<const parsed_domain> domain,
 		std::list<expression::exp_case*>& cases,
 		std::list<expression::node*>& output,
 		std::list<expression::node*>& operators,
 		std::vector<named_variable*>& used_variables,
+		expression_typing* typing,
 		std::string& error
 	)
 	{
 		using node = expression::node;
 		using node_type = node::node_type;
 
-		auto push_vector_or_parenthesis = [&]()
+		//pushes the node to the output; if the expression is typed, the node is validated right away
+		auto push_output = [&](node* n)
 		{
-			int comas = get_comas_inside_parenthesis(source, iterator - 1, error);
-			rethrow_error();
+			output.push_back(n);
+
+			if (typing == nullptr) return;
 
-			node* new_node;
+			size_t operands = 0;
 
-			if (comas == 0)
+			switch (n->get_type())
 			{
-				new_node = node::new_left_parenthesis();
-				operators.push_back(new_node);
+			case node_type::left_parenthesis:
+				throw_error(true, "Mismatched parentheses");
+			case node_type::binary_operator:
+				operands = 2; break;
+			case node_type::unary_operator:
+			case node_type::vector_component_access_operator:
+				operands = 1; break;
+			case node_type::vector_contructor_operator:
+				operands = n->as_vector_contructor_operator().first; break;
+			case node_type::function:
+				operands = n->as_function()->second.arguments.size(); break;
+			default:
+				break;
 			}
-			else if (comas <= 3)
+
+			throw_error(typing->types.size() < operands, "Invalid expression");
+
+			validate_node(typing->used_functions, n, typing->types, domain, error);
+		};
+
+		auto insert_operator = [&](node* new_node)
+		{
+			while (operators.size() != 0)
 			{
-				new_node = node::new_vector_contructor_operator(comas + 1, 0);
-				operators.push_back(new_node);
-			}		
-			else
-				error = "Constructed vector is too long";
+				auto previous = operators.back();
+				if (
+					previous->get_type() != node_type::left_parenthesis &&
+					previous->get_type() != node_type::vector_contructor_operator &&
+					previous->get_type() != node_type::function &&
+					get_precedence(previous) >= get_precedence(new_node)
+					)
+				{
+					operators.pop_back();
+					push_output(previous);
+					rethrow_error();
+				}
+				else break;
+			}
 
-			
+			operators.push_back(new_node);
+		};
+
+		//parentheses (and function calls) opened so far; commas are counted here so the vector size
+		//or arguments ammount is known once the matching ) is met, without scanning ahead
+		struct open_parenthesis
+		{
+			int comas = 0;
+			bool empty = false;
+		};
+
+		std::vector<open_parenthesis> open_parentheses;
+
+		auto push_parenthesis = [&]()
+		{
+			operators.push_back(node::new_left_parenthesis());
+			open_parentheses.push_back({});
 		};
 
 		auto close_parenthesis = [&]()
@@ -246,21 +174,39 @@ namespace expressions_parsing_utilities
 					break;
 				}
 
-				output.push_back(previous);
 				operators.pop_back();
+				push_output(previous);
+				rethrow_error();
 			}
 
-			if (!found_left_parenthesis)
-				error = "Mismatched parentheses";
-			else if (previous->get_type() == node_type::left_parenthesis)
+			throw_error(!found_left_parenthesis || open_parentheses.size() == 0, "Mismatched parentheses");
+
+			auto parenthesis = open_parentheses.back();
+			open_parentheses.pop_back();
+
+			if (previous->get_type() == node_type::left_parenthesis)
 			{
 				delete operators.back();
 				operators.pop_back();
+
+				if (parenthesis.comas == 0) return;
+
+				throw_error(parenthesis.comas > 3, "Constructed vector is too long");
+				push_output(node::new_vector_contructor_operator(parenthesis.comas + 1, 0));
 			}
 			else
 			{
-				output.push_back(previous);
+				auto func = previous->as_function();
+				size_t args_ammount = parenthesis.empty ? 0 : parenthesis.comas + 1;
+
+				throw_error(func->second.arguments.size() != args_ammount,
+					"Function " + func->first
+					+ " takes " + std::to_string(func->second.arguments.size())
+					+ " arguments, not " + std::to_string(args_ammount);
+				);
+
 				operators.pop_back();
+				push_output(previous);
 			}
 		};
 
@@ -271,22 +217,32 @@ namespace expressions_parsing_utilities
 				auto previous = operators.back();
 				if (is_any_of_left_parentheses(previous))
 					break;
-				output.push_back(previous);
 				operators.pop_back();
+				push_output(previous);
+				rethrow_error();
 			}
+
+			if (open_parentheses.size() != 0)
+				open_parentheses.back().comas++;
 		};
 
 		auto check_expression = [&]()
 		{
 			//Push all binary_operators left on the binary_operators stack to the output
-			auto itr = operators.rbegin();
-			while (itr != operators.rend())
+			while (operators.size() != 0)
 			{
-				output.push_back(*itr);
-				itr++;
+				auto previous = operators.back();
+				operators.pop_back();
+				push_output(previous);
+				rethrow_error();
 			}
 
-			operators.clear();
+			//typed expressions are checked while being pushed to the output
+			if (typing != nullptr)
+			{
+				throw_error(typing->types.size() != 1, "Invalid expression");
+				return;
+			}
 
 			size_t operands_check_sum = 0;
 			for (auto& n : output)
@@ -325,7 +281,28 @@ namespace expressions_parsing_utilities
 			throw_error(operands_check_sum != 1, "Invalid expression");
 		};
 
-		get_spaces(source, iterator);
+		//checks the type of the just finished condition or value of the case with given number
+		auto check_case_type = [&](bool condition, size_t case_number)
+		{
+			if (typing == nullptr) return;
+
+			const data_type* type = typing->types.back();
+			typing->types.clear();
+
+			if (condition)
+			{
+				throw_error(type != bool_data_type, 
+					"Conditions must evaluate to bool. Condition number " + std::to_string(case_number) + " evaluate to: " + type->name);
+			}
+			else if (typing->type == nullptr)
+				typing->type = type;
+			else
+			{
+				throw_error(type != typing->type, 
+					"Variable type must be same in all if cases. First expression type: " + typing->type->name + ", "
+					"Expression number " + std::to_string(case_number) + " type: " + type->name);
+			}
+		};
 
 		bool accepts_right_unary_operator = true;
 		bool expecting_library_function = false;
@@ -341,16 +318,10 @@ namespace expressions_parsing_utilities
 	_shunting_yard_loop:
 		while (!is_at_line_end(source, iterator))
 		{
-			auto node_str = get_node_str(source, iterator, error);
-			rethrow_error();
-
-			if (node_str.at(0) == comment_char)
-				goto _shunting_yard_end;		//error for multline
+			auto& node_token = source.at(iterator++);
+			auto node_str = source.get_string(node_token);
 
-			{
-				size_t iterator2 = iterator;
-				throw_error(expecting_library_function && !is_function_call(source, iterator2), "Expected function call");
-			}
+			throw_error(expecting_library_function && !is_function_call(source, iterator), "Expected function call");
 
 			if (node_str == "if")
 			{
@@ -361,6 +332,9 @@ namespace expressions_parsing_utilities
 				if (if_used)
 				{
 					check_expression();
+					rethrow_error();
+					check_case_type(false, cases.size());
+					rethrow_error();
 					cases.back()->value = new expression::single_expression(output);
 				}
 
@@ -374,6 +348,9 @@ namespace expressions_parsing_utilities
 				throw_error(else_used, "Cannot specify two else cases");
 
 				check_expression();
+				rethrow_error();
+				check_case_type(false, cases.size());
+				rethrow_error();
 				cases.back()->value = new expression::single_expression(output);
 
 				else_used = true;
@@ -382,6 +359,7 @@ namespace expressions_parsing_utilities
 			else if (node_str == ":")
 			{
 				if (!else_used) check_expression();
+				rethrow_error();
 
 				throw_error(!if_used, ": can be only used after if or else statements");
 				throw_error(output.size() == 0 && !else_used, "Missing condition");
@@ -389,6 +367,8 @@ namespace expressions_parsing_utilities
 
 				if (!else_used)
 				{
+					check_case_type(true, cases.size() + 1);
+					rethrow_error();
 					cases.push_back(new expression::exp_case{
 						new expression::single_expression(output),
 						nullptr
@@ -413,24 +393,26 @@ namespace expressions_parsing_utilities
 			else if (is_unary_operator(node_str) && accepts_right_unary_operator)
 			{
 				auto new_node = node::new_unary_operator(get_unary_operator(node_str));
-				insert_operator(operators, output, new_node);
+				insert_operator(new_node);
+				rethrow_error();
 				accepts_right_unary_operator = false;
 			}
 			else if (is_binary_operator(node_str))
 			{
 				auto new_node = node::new_binary_operator(get_binary_operator(node_str));
-				insert_operator(operators, output, new_node);
+				insert_operator(new_node);
+				rethrow_error();
 				accepts_right_unary_operator = true;
 			}
 			else if (node_str.at(0) == '(')
 			{
-				push_vector_or_parenthesis();
-				rethrow_error();
+				push_parenthesis();
 				accepts_right_unary_operator = true;
 			}
 			else if (node_str.at(0) == ')')
 			{
 				close_parenthesis();
+				rethrow_error();
 				accepts_right_unary_operator = false;
 			}
 			else if (node_str.at(0) == ',')
@@ -445,7 +427,6 @@ namespace expressions_parsing_utilities
 			}
 			else if (node_str.at(0) == '.' && output.size() != 0)
 			{
-				get_spaces(source, iterator);
 				auto components = get_string_ref(source, iterator, error);
 
 				rethrow_error();
@@ -456,7 +437,7 @@ namespace expressions_parsing_utilities
 				for (size_t i = 0; i < components.size(); i++)
 				{
 					auto itr = vector_components_names.find(components.at(i));
-					throw_error(itr == vector_components_names.end(), error = "No such vector component: " + components.at(i));
+					throw_error(itr == vector_components_names.end(), std::string("No such vector component: ") + components.at(i));
 					included_vector_components.push_back(itr->second);
 				}
 
@@ -466,7 +447,6 @@ namespace expressions_parsing_utilities
 			}
 			else if (node_str.at(0) == '.' && expecting_exposed)
 			{
-				get_spaces(source, iterator);
 				auto symbol_name = get_string_ref(source, iterator, error);
 				rethrow_error();
 
@@ -481,7 +461,8 @@ namespace expressions_parsing_utilities
 
 				auto new_node = node::new_symbol(&(itr->second));
 
-				output.push_back(new_node);
+				push_output(new_node);
+				rethrow_error();
 				accepts_right_unary_operator = false;
 				expecting_exposed = false;
 			}
@@ -489,41 +470,35 @@ namespace expressions_parsing_utilities
 			{
 				throw_error(true, "Invalid expression");
 			}
-			else if (is_scalar_literal(node_str, error))
+			else if (node_token.kind == token_kind::scalar_literal)
 			{
-				rethrow_error();
+				throw_error(node_str.at(node_str.size() - 1) == '.', "Invalid scalar literal: " + std::string(node_str));
 				auto new_node = node::new_scalar_literal(node_str);
-				output.push_back(new_node);
+				push_output(new_node);
+				rethrow_error();
 				accepts_right_unary_operator = false;
 			}
 			else if (is_function_call(source, iterator))
 			{
 			_shunting_yard_function:
-				throw_error(functions == nullptr, "Cannot use functions here");
+				throw_error(names == nullptr, "Cannot use functions here");
 
-				int args_ammount = get_comas_inside_parenthesis(source, iterator - 1, error);
-				rethrow_error();
-
-				iterator++; //Jump over the ( char
+				iterator++; //Jump over the ( token
 				throw_error(is_at_source_end(source, iterator), "Unexpected file end");
 
-				if (args_ammount != 0)
-					args_ammount++;
-				else
-				{
-					get_spaces(source, iterator);
-					if (source.at(iterator) != ')')
-						args_ammount = 1;
-				}
+				//the arguments ammount is checked once the call is closed
+				open_parenthesis call;
+				call.empty = is_operator_token(source, iterator, ")");
 
-				function_collection::iterator itr;
+				named_function* function = nullptr;
 				if (expecting_library_function)
 				{
 					expecting_library_function = false;
 					auto& library = output.back()->as_library();
 
-					itr = library->functions.find(node_str);
+					auto itr = library->functions.find(node_str);
 					throw_error(itr == library->functions.end(), "No such function: " + std::string(node_str));
+					function = &(*itr);
 					delete output.back();
 					output.pop_back();
 				}
@@ -533,121 +508,126 @@ namespace expressions_parsing_utilities
 					//(since they are exposed) so their state is not going to change
 					expecting_exposed = false;
 
-					itr = const_cast<parsed_domain*>(domain.get())->functions.find(node_str);
+					auto itr = const_cast<parsed_domain*>(domain.get())->functions.find(node_str);
 					throw_error(itr == domain->functions.end(), "No such function: " + std::string(node_str));
-					goto _shunting_yard_process_function;
+					function = &(*itr);
 				}
 				else
 				{
-					itr = functions->find(node_str);
-					if (itr != functions->end()) goto _shunting_yard_process_function;
-
-					//this one also is not going to be instanciated
-					itr = const_cast<context_public_implementation&>(context_impl).common_functions.find(node_str);
-					if (itr != context_impl.common_functions.end()) goto _shunting_yard_process_function;
-
-					throw_error(true, "No such function: " + std::string(node_str));
+					//common functions are found in the context's scope, they are not going to be instanciated either
+					auto entity = names->find(node_str);
+					throw_error(entity == nullptr || entity->get_type() != scope_entity::entity_type::function, 
+						"No such function: " + std::string(node_str));
+					function = entity->as_function();
 				}
 
-			_shunting_yard_process_function:
-				throw_error(expecting_library_function && !itr->second.valid, "Cannot use invalid function: " + std::string(library_name) + "." + std::string(node_str));
-				throw_error(!itr->second.valid, "Cannot use invalid function: " + std::string(node_str));
+				if (function->second.library != nullptr)
+				{
+					auto& mutable_context = const_cast<context_public_implementation&>(context_impl);
+					std::lock_guard<std::recursive_mutex> lock(mutable_context.libraries_mutex);
+
+					if (function->second.lazy_body)
+					{
+						parse_lazy_function_body(function->second, mutable_context, error);
+						throw_error(error != "", "Cannot use invalid function: " + function->second.library->first + "." + std::string(node_str) + "; " + error);
+					}
+				}
 
-				throw_error(itr->second.arguments.size() != args_ammount,
-					"Function " + std::string(node_str)
-					+ " takes " + std::to_string(itr->second.arguments.size())
-					+ " arguments, not " + std::to_string(args_ammount);
-				);
+				throw_error(expecting_library_function && !function->second.valid, "Cannot use invalid function: " + std::string(library_name) + "." + std::string(node_str));
+				throw_error(!function->second.valid, "Cannot use invalid function: " + std::string(node_str));
 
-				throw_error((*itr).second.returned_value == nullptr && !(*itr).second.is_exposed,
+				throw_error(function->second.returned_value == nullptr && !function->second.is_exposed,
 					"Cannot use function: " + std::string(node_str) + " because it is missing return statement"
 				);
 
-				auto new_node = node::new_function(&(*itr));
-				insert_operator(operators, output, new_node);
+				auto new_node = node::new_function(function);
+				insert_operator(new_node);
+				rethrow_error();
+				open_parentheses.push_back(call);
 				accepts_right_unary_operator = true;
 			}
 			else
 			{
 				accepts_right_unary_operator = false;
 
-				throw_error(variables == nullptr, "Cannot use variables, parameters and functions in here");
+				throw_error(names == nullptr || !names->allows_values(), "Cannot use variables, parameters and functions in here");
 
-				//Check if variable
-				auto itr = variables->find(node_str);
+				auto entity = names->find(node_str);
+				throw_error(entity == nullptr, "No such variable: " + std::string(node_str));
 
-				if (itr != variables->end())
+				switch (entity->get_type())
 				{
-					auto new_node = node::new_variable(&(*itr));
-					output.push_back(new_node);
-					used_variables.push_back(&(*itr));
-
+				case scope_entity::entity_type::variable:
+				{
+					auto new_node = node::new_variable(entity->as_variable());
+					push_output(new_node);
+					used_variables.push_back(entity->as_variable());
+					rethrow_error();
 					continue;
 				}
-
-				auto itr2 = parameters->find(node_str);
-				if (parameters != nullptr && itr2 != parameters->end())
+				case scope_entity::entity_type::parameter:
 				{
-					auto new_node = node::new_parameter(&(*itr2));
-					output.push_back(new_node);
+					auto new_node = node::new_parameter(entity->as_parameter());
+					push_output(new_node);
+					rethrow_error();
 					continue;
 				}
-
-				//Check if library
-				auto itr3 = libraries->find(node_str);
-				throw_error(itr3 == libraries->end(), "No such variable: " + std::string(node_str));
-
-				library_name = { node_str };
-				auto new_node = node::new_library(itr3->second);
-				output.push_back(new_node);
+				case scope_entity::entity_type::library:
+				{
+					library_name = { node_str };
+					auto new_node = node::new_library(entity->as_library()->second);
+					push_output(new_node);
+					break;
+				}
+				default:
+					throw_error(true, "No such variable: " + std::string(node_str));
+				}
 			}
-
-			get_spaces(source, iterator);
 		}
 
 		if (is_at_source_end(source, iterator)) goto _shunting_yard_end;
 
-		{
-			size_t iterator_2 = iterator;
-			get_to_new_line(source, iterator_2);
-
-			int spaces = get_spaces(source, iterator_2);
+		throw_error(open_parentheses.size() != 0, "Mismatched parentheses");
 
-			if (is_at_source_end(source, iterator_2)) goto _shunting_yard_end;
+		//the expression continues on the next line, if that line is more indented and starts with a name or a literal
+		{
+			auto& next_line = source.at(iterator);
+			auto& first_token = source.at(iterator + 1);
 
-			if (spaces > indentation)
+			if (
+				next_line.line == source.at(iterator - 1).line + 1 &&
+				next_line.indentation > indentation &&
+				(first_token.kind == token_kind::name || first_token.kind == token_kind::scalar_literal)
+			)
 			{
-				std::string temp_error;
-
-				size_t iterator_3 = iterator_2;
-				auto str = get_string_ref(source, iterator_3, temp_error);
-
-				if (temp_error != "")
-					goto _shunting_yard_end;
-
 				lines_counter++;
-				iterator = iterator_2;
+				iterator++;
 				goto _shunting_yard_loop;
 			}
 		}
 
 	_shunting_yard_end:
+		throw_error(open_parentheses.size() != 0, "Mismatched parentheses");
 		check_expression();
+		rethrow_error();
 
 		throw_error(expecting_library_function, "Invalid expression");
-		throw_error(if_used && !else_used, "Each if statement must go along with an else statement")
-
-			if (cases.size() != 0)
-				cases.back()->value = new expression::single_expression(output);
-			else
-				cases.push_back(new expression::exp_case{
-					nullptr,
-					new expression::single_expression(output)
-					});
+		throw_error(if_used && !else_used, "Each if statement must go along with an else statement");
+
+		check_case_type(false, cases.size() != 0 ? cases.size() : 1);
+		rethrow_error();
+
+		if (cases.size() != 0)
+			cases.back()->value = new expression::single_expression(output);
+		else
+			cases.push_back(new expression::exp_case{
+				nullptr,
+				new expression::single_expression(output)
+				});
 	}
 
 	inline void validate_node(
-		expression* exp,
+		decltype(expression::used_functions)& used_functions,
 		expression::node* n,
 		std::vector<const data_type*>& types,
 		const std::shared_ptr<const parsed_domain>& domain,
@@ -671,12 +651,11 @@ namespace expressions_parsing_utilities
 			auto left = get_type(1);
 			auto right = get_type(0);
 
-			for (auto& at : op->allowed_types)
+			auto returned_type = op->get_returned_type(left, right);
+			if (returned_type != nullptr)
 			{
-				if (at.left_operand_type != left || at.right_operand_type != right) continue;
-
 				pop_types(2);
-				types.push_back(at.returned_type);
+				types.push_back(returned_type);
 				return;
 			}
 			error = "Cannot " + op->operation_display_name + " types: left: " + left->name + " right: " + right->name;
@@ -686,12 +665,11 @@ namespace expressions_parsing_utilities
 		{
 			auto operand = get_type(0);
 
-			for (auto& at : op->allowed_types)
+			auto returned_type = op->get_returned_type(operand);
+			if (returned_type != nullptr)
 			{
-				if (at.operand_type != operand) continue;
-
 				pop_types(1);
-				types.push_back(at.returned_type);
+				types.push_back(returned_type);
 				return;
 			}
 			std::string error = "Cannot " + op->operation_display_name + " type: " + operand->name;
@@ -742,35 +720,33 @@ namespace expressions_parsing_utilities
 			auto& func_name = n->as_function()->first;
 			auto& func_def = n->as_function()->second;
 
-			std::vector<const data_type*> arguments_types;
-
-			for (size_t i = func_def.arguments.size() - 1; i != -1; i--)
-				arguments_types.push_back(get_type(i));
+			//arguments types are the last ones on the stack, in order
+			auto arguments_begin = types.end() - func_def.arguments.size();
 
 			auto invalid_arguments_error = [&]()
 			{
 				auto the_error = "Function " + func_name + " is invalid for arguments: ";
-				for (size_t i = 0; i < arguments_types.size(); i++)
+				for (auto itr = arguments_begin; itr != types.end(); itr++)
 				{
-					the_error += arguments_types.at(i)->name;
-					if (i != arguments_types.size() - 1) the_error += ", ";
+					the_error += (*itr)->name;
+					if (itr != types.end() - 1) the_error += ", ";
 				}
 				return the_error;
 			};
 
-			for (auto& func_instance : func_def.instances)
+			auto lock = lock_function_instances(func_def);
+
+			auto func_instance = func_def.instances.find(arguments_begin, types.end());
+			if (func_instance != nullptr)
 			{
-				if (func_instance.args_matching(arguments_types))
-				{
-					throw_error(!func_instance.valid, invalid_arguments_error());
+				throw_error(!func_instance->valid, invalid_arguments_error());
 
-					pop_types(func_def.arguments.size());
-					types.push_back(func_instance.returned_type);
+				pop_types(func_def.arguments.size());
+				types.push_back(func_instance->returned_type);
 
-					exp->used_functions.back().push_back(&func_instance);
+				used_functions.back().push_back(func_instance);
 
-					return;
-				}
+				return;
 			}
 
 			if (func_def.is_exposed)
@@ -778,12 +754,11 @@ namespace expressions_parsing_utilities
 
 			instantiate_function(
 				func_def,
-				arguments_types,
-				exp->used_functions,
+				{ arguments_begin, types.end() },
 				error
 			);
 
-			exp->used_functions.back().push_back(&func_def.instances.back());
+			used_functions.back().push_back(&func_def.instances.back());
 
 			if (error != "")
 				error = invalid_arguments_error() + '\n' + error;
@@ -861,16 +836,14 @@ namespace expressions_parsing_utilities
 }
 
 expression* get_expression(
-	const std::string& source,
+	const tokenized_source& source,
 	size_t& iterator,
 	const int& indentation,
 	int& line_counter,
-	variables_collection* variables,
-	parameters_collection* parameters,
-	function_collection* functions,
-	libraries_collection* libraries,
+	const names_scope* names,						//scope in which the names used by the expression are resolved, nullptr if only literals and symbols are allowed
 	const context_public_implementation& context,
 	std::shared_ptr<const parsed_domain> domain,	//optional, nullptr if symbols are not allowed
+	const data_type** type,							//optional, if given the expression is validated while parsed and its type is written here
 	std::string& error
 )
 {
@@ -879,23 +852,22 @@ expression* get_expression(
 	std::list<expression::node*> operators;
 
 	std::vector<named_variable*> used_vars;
-	std::vector<function_instance*> used_funcs;
+
+	expressions_parsing_utilities::expression_typing typing;
 
 	expressions_parsing_utilities::shunting_yard(
 		source,
 		iterator,
 		indentation,
 		line_counter,
-		variables,
-		parameters,
-		functions,
-		libraries,
+		names,
 		context,
 		domain,
 		cases,
 		output,
 		operators,
 		used_vars,
+		type != nullptr ? &typing : nullptr,
 		error
 	);
 
@@ -913,7 +885,11 @@ expression* get_expression(
 		return nullptr;
 	}
 
-	return new expression(cases, used_vars, {});
+	if (type == nullptr)
+		return new expression(cases, used_vars, {});
+
+	*type = typing.type;
+	return new expression(cases, used_vars, std::move(typing.used_functions));
 }
 
 const data_type* validate_expression(
@@ -933,7 +909,7 @@ const data_type* validate_expression(
 	{
 		for (auto& n : le->nodes)
 		{
-			expressions_parsing_utilities::validate_node(exp, n, types, domain, error);
+			expressions_parsing_utilities::validate_node(exp->used_functions, n, types, domain, error);
 			if (error != "") break;
 		}
 
@@ -984,11 +960,31 @@ const data_type* validate_expression(
 
 void instantiate_function(
 	function_definition& func_def,
-	const std::vector<const data_type*> arguments,
-	decltype(expression::used_functions)& used_functions,
+	std::vector<const data_type*> arguments,
 	std::string& error
 )
 {
+	//every call in the body gets resolved in the expression's table for this instance (its last table),
+	//the instance itself keeps the list of all instances it calls, directly or not
+	//callees are already instantiated, so their own lists are complete
+	std::vector<function_instance*> called_instances;
+	std::unordered_set<const function_instance*> called;
+
+	auto add_called_instances = [&](const expression* exp)
+	{
+		for (auto& callee : exp->used_functions.back())
+		{
+			if (called.find(callee) != called.end()) continue;
+
+			for (auto& nested : callee->called_instances)
+				if (called.insert(nested).second)
+					called_instances.push_back(nested);
+
+			called.insert(callee);
+			called_instances.push_back(callee);
+		}
+	};
+
 	auto itr = func_def.variables.begin();
 	for (auto arg = arguments.begin(); arg != arguments.end(); arg++)
 	{
@@ -1018,8 +1014,7 @@ void instantiate_function(
 			error += error2;
 		}
 
-		for (auto& func : var.value->used_functions)
-			used_functions.push_back(func);
+		add_called_instances(var.value);
 
 		itr++;
 	}
@@ -1027,14 +1022,12 @@ void instantiate_function(
 	std::string error2;
 	auto type = validate_expression(func_def.returned_value, nullptr, error2);
 
-	for (auto& func : func_def.returned_value->used_functions)
-		used_functions.push_back(func);
+	add_called_instances(func_def.returned_value);
 
-	func_def.instances.push_back({ &func_def });
-	auto& instance = func_def.instances.back();
+	auto& instance = func_def.instances.add(&func_def, std::move(arguments));
 
 	instance.valid = error == "";
-	instance.arguments_types = arguments;
+	instance.called_instances = std::move(called_instances);
 
 	if (!instance.valid) return;
 
@@ -1,5 +1,8 @@
 #pragma once
 
+//heterogeneous_map searches linearly until it has this many records, then it keeps an index of the keys hashes
+const size_t heterogeneous_map_indexing_threshold = 16;
+
 template<class _key, class _value, class _equality_solver>
 class heterogeneous_map
 {
@@ -10,17 +13,97 @@ public:
 
 private:
 	std::list<record> records;
+	std::unordered_multimap<size_t, iterator> index;
+
+	inline bool is_indexed() const
+	{
+		return records.size() >= heterogeneous_map_indexing_threshold;
+	}
+
+	inline void build_index()
+	{
+		index.clear();
+
+		if (!is_indexed()) return;
+
+		index.reserve(records.size());
+		for (iterator itr = records.begin(); itr != records.end(); itr++)
+			index.insert({ _equality_solver::hash(itr->first), itr });
+	}
+
+	template<class _key2>
+	inline iterator find_record(const _key2& key)
+	{
+		if (!is_indexed())
+		{
+			for (iterator itr = records.begin(); itr != records.end(); itr++)
+				if (_equality_solver::equal(itr->first, key))
+					return itr;
+			return records.end();
+		}
+
+		auto range = index.equal_range(_equality_solver::hash(key));
+		for (auto itr = range.first; itr != range.second; itr++)
+			if (_equality_solver::equal(itr->second->first, key))
+				return itr->second;
+		return records.end();
+	}
+
+	template<class _key2>
+	inline const_iterator find_record(const _key2& key) const
+	{
+		if (!is_indexed())
+		{
+			for (const_iterator itr = records.begin(); itr != records.end(); itr++)
+				if (_equality_solver::equal(itr->first, key))
+					return itr;
+			return records.end();
+		}
+
+		auto range = index.equal_range(_equality_solver::hash(key));
+		for (auto itr = range.first; itr != range.second; itr++)
+			if (_equality_solver::equal(itr->second->first, key))
+				return itr->second;
+		return records.end();
+	}
 
 public:
 	heterogeneous_map() {};
 	heterogeneous_map(std::list<record> __records)
-		: records(std::move(__records)) {};
+		: records(std::move(__records)) 
+	{
+		build_index();
+	};
+
+	//the index holds iterators of the records list, so it must be rebuilt for the copied list
+	heterogeneous_map(const heterogeneous_map& other)
+		: records(other.records)
+	{
+		build_index();
+	};
+
+	heterogeneous_map(heterogeneous_map&& other) = default;
+
+	heterogeneous_map& operator=(const heterogeneous_map& other)
+	{
+		records = other.records;
+		build_index();
+		return *this;
+	};
+
+	heterogeneous_map& operator=(heterogeneous_map&& other) = default;
 
 	inline size_t size() const
 	{
 		return records.size();
 	}
 
+	inline void clear()
+	{
+		records.clear();
+		index.clear();
+	}
+
 	inline iterator begin()
 	{
 		return records.begin();
@@ -54,37 +137,29 @@ public:
 	template<class _key2>
 	inline _value& at(const _key2& key)
 	{
-		for (iterator itr = begin(); itr != end(); itr++)
-			if (_equality_solver::equal(itr->first, key))
-				return itr->second;
-		throw std::exception{};
+		iterator itr = find_record(key);
+		if (itr == end()) throw std::exception{};
+		return itr->second;
 	}
 
 	template<class _key2>
 	inline const _value& at(const _key2& key) const
 	{
-		for (const_iterator itr = begin(); itr != end(); itr++)
-			if (_equality_solver::equal(itr->first, key))
-				return itr->second;
-		throw std::exception{};
+		const_iterator itr = find_record(key);
+		if (itr == end()) throw std::exception{};
+		return itr->second;
 	}
 
 	template<class _key2>
 	inline iterator find(const _key2& key)
 	{
-		for (iterator itr = begin(); itr != end(); itr++)
-			if (_equality_solver::equal(itr->first, key))
-				return itr;
-		return end();
+		return find_record(key);
 	}
 
 	template<class _key2>
 	inline const_iterator find(const _key2& key) const
 	{
-		for (const_iterator itr = begin(); itr != end(); itr++)
-			if (_equality_solver::equal(itr->first, key))
-				return itr;
-		return end();
+		return find_record(key);
 	}
 
 	inline iterator insert(record record)
@@ -94,7 +169,14 @@ public:
 		if (itr == end())
 		{
 			records.push_back(std::move(record));
-			return --records.end();
+			itr = --records.end();
+
+			if (records.size() == heterogeneous_map_indexing_threshold)
+				build_index();
+			else if (is_indexed())
+				index.insert({ _equality_solver::hash(itr->first), itr });
+
+			return itr;
 		}
 		else
 		{
@@ -109,18 +191,63 @@ public:
 			insert(*itr);
 	}
 
+	//changes the key of the record in place, so pointers to the record stay valid
+	inline void rename(iterator itr, _key key)
+	{
+		if (is_indexed())
+		{
+			auto range = index.equal_range(_equality_solver::hash(itr->first));
+			for (auto index_itr = range.first; index_itr != range.second; index_itr++)
+				if (index_itr->second == itr)
+				{
+					index.erase(index_itr);
+					break;
+				}
+		}
+
+		itr->first = std::move(key);
+
+		if (is_indexed())
+			index.insert({ _equality_solver::hash(itr->first), itr });
+	}
+
 	inline void remove(const _key& key)
 	{
-		for (const_iterator itr = begin(); itr != end(); itr++)
-			if (_equality_solver::equal(itr->first, key))
-			{
-				records.remove(*itr);
-				return;
-			}
-		throw std::exception{};
+		iterator itr = find_record(key);
+		if (itr == end()) throw std::exception{};
+
+		if (is_indexed())
+		{
+			auto range = index.equal_range(_equality_solver::hash(key));
+			for (auto index_itr = range.first; index_itr != range.second; index_itr++)
+				if (index_itr->second == itr)
+				{
+					index.erase(index_itr);
+					break;
+				}
+		}
+
+		records.erase(itr);
+
+		if (records.size() == heterogeneous_map_indexing_threshold - 1)
+			index.clear();
 	}
 };
 
+//FNV-1a
+inline size_t hash_chars(const char* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 1099511628211ull;
+	}
+
+	return static_cast<size_t>(hash);
+}
+
 struct hgm_string_solver
 {
 	static inline bool equal(const std::string& parameters_declarations_translator, const std::string& b)
@@ -132,6 +259,16 @@ struct hgm_string_solver
 	{
 		return b == parameters_declarations_translator;
 	}
+
+	static inline size_t hash(const std::string& key)
+	{
+		return hash_chars(key.data(), key.size());
+	}
+
+	static inline size_t hash(const string_view& key)
+	{
+		return hash_chars(key.data(), key.size());
+	}
 };
 
 struct hgm_pointer_solver
@@ -140,4 +277,9 @@ struct hgm_pointer_solver
 	{
 		return parameters_declarations_translator == b;
 	}
+
+	static inline size_t hash(void* key)
+	{
+		return std::hash<void*>{}(key);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,217 @@
+#pragma once
+
+/*
+	Lexer of the materials and libraries sources; the whole source is split into a flat array of tokens in a single pass,
+	so keywords handles and the expressions parser read tokens instead of walking the characters again
+	Comments and blank lines produce no tokens; every other line starts with a line_begin token, the array ends with a source_end token
+	- kind : what the token is, see token_kind
+	- line : number of the token's line, counted from 1
+	- indentation : indentation of the line in spaces (tab counts as 4 spaces), set for line_begin tokens only
+	- begin, end : span of the token in the source
+	- literal_value : value of the scalar literal, computed when the token is made; set for valid scalar_literal tokens only
+*/
+enum class token_kind : uint8_t
+{
+	line_begin,
+	name,				//any run of characters that are not operators nor whitespaces: keywords, names, vector components
+	scalar_literal,		//digits with at most one dot; literal that ends with the dot is still a literal, so the parser can report it
+	operato,			//single operator character, or one of the comparisons: ==, !=, <=, >=
+	source_end
+};
+
+struct token
+{
+	token_kind kind;
+	int line = 0;
+	int indentation = 0;
+	size_t begin = 0;
+	size_t end = 0;
+	float literal_value = 0;
+};
+
+struct tokenized_source
+{
+	source_view source;
+	std::vector<token> tokens;
+
+	inline const token& at(size_t index) const
+	{
+		return tokens.at(index);
+	}
+
+	inline string_view get_string(const token& token) const
+	{
+		return { source, token.begin, token.end };
+	}
+};
+
+//splits the source into tokens; same as the characters scanners, the source ends at its size or at the first '\0'
+inline void tokenize_source(const source_view& source, tokenized_source& tokenized)
+{
+	tokenized.source = source;
+
+	auto& tokens = tokenized.tokens;
+	tokens.clear();
+	tokens.reserve(source.size() / 3 + 1);
+
+	const size_t size = source.size();
+	size_t iterator = 0;
+	int line = 0;
+
+	auto is_line_end = [&](size_t position)
+	{
+		return position >= size || source[position] == '\n' || source[position] == '\0';
+	};
+
+	while (iterator < size && source[iterator] != '\0')
+	{
+		line++;
+
+		int indentation = get_spaces(source, iterator);
+		bool line_begun = false;
+
+		while (!is_line_end(iterator))
+		{
+			const char c = source[iterator];
+
+			if (c == ' ' || c == '\t')
+			{
+				iterator++;
+				continue;
+			}
+
+			if (c == comment_char)
+			{
+				while (!is_line_end(iterator)) iterator++;
+				break;
+			}
+
+			if (!line_begun)
+			{
+				line_begun = true;
+				tokens.push_back({ token_kind::line_begin, line, indentation, iterator, iterator });
+			}
+
+			token new_token;
+			new_token.line = line;
+			new_token.begin = iterator;
+
+			if (is_operator(c))
+			{
+				iterator++;
+				if ((c == '!' || c == '>' || c == '<' || c == '=') && iterator < size && source[iterator] == '=')
+					iterator++;
+
+				new_token.kind = token_kind::operato;
+				new_token.end = iterator;
+				tokens.push_back(new_token);
+				continue;
+			}
+
+			//a dot continues the run only inside a number, so 0.5 is a single token but v.x is not
+			bool only_digits = true;
+			bool dot_used = false;
+
+			while (iterator < size)
+			{
+				const char& c = source[iterator];
+
+				if (is_whitespace(c)) break;
+
+				if (is_operator(c))
+				{
+					if (c != '.' || !only_digits || dot_used) break;
+					dot_used = true;
+				}
+				else if (!is_digit(c))
+					only_digits = false;
+
+				iterator++;
+			}
+
+			new_token.kind = only_digits ? token_kind::scalar_literal : token_kind::name;
+			new_token.end = iterator;
+
+			if (only_digits && source[iterator - 1] != '.')
+				new_token.literal_value = std::strtof(std::string(source.data() + new_token.begin, iterator - new_token.begin).c_str(), nullptr);
+
+			tokens.push_back(new_token);
+		}
+
+		if (iterator >= size || source[iterator] == '\0') break;
+		iterator++;
+	}
+
+	tokens.push_back({ token_kind::source_end, line, 0, iterator, iterator });
+}
+
+inline bool is_at_line_end(const tokenized_source& source, const size_t& iterator)
+{
+	auto kind = source.at(iterator).kind;
+	return kind == token_kind::line_begin || kind == token_kind::source_end;
+}
+
+inline bool is_at_source_end(const tokenized_source& source, const size_t& iterator)
+{
+	return source.at(iterator).kind == token_kind::source_end;
+}
+
+//whether the token is the given operator
+inline bool is_operator_token(const tokenized_source& source, const size_t& iterator, const char* operato)
+{
+	auto& token = source.at(iterator);
+	if (token.kind != token_kind::operato) return false;
+
+	size_t length = std::strlen(operato);
+	return token.end - token.begin == length && std::equal(operato, operato + length, source.source.data() + token.begin);
+}
+
+//skips the rest of the line, stops at the next line's line_begin token
+inline void get_to_new_line(const tokenized_source& source, size_t& iterator)
+{
+	while (!is_at_line_end(source, iterator))
+		iterator++;
+}
+
+//name or literal token; operators and line end are reported the same way the characters scanner reports them
+inline string_view get_string_ref(const tokenized_source& source, size_t& iterator, std::string& error)
+{
+	auto& token = source.at(iterator);
+
+	if (is_at_line_end(source, iterator))
+	{
+		error = "Expected token not: new line";
+		return { source.source, token.begin, token.begin };
+	}
+
+	if (token.kind == token_kind::operato)
+	{
+		error = "Expected token not: " + std::string(source.get_string(token));
+		return { source.source, token.begin, token.begin };
+	}
+
+	iterator++;
+	return source.get_string(token);
+}
+
+//whether the next token is the given operator; if so, the operator is skipped
+inline bool get_operator(const tokenized_source& source, size_t& iterator, const char* operato)
+{
+	if (!is_operator_token(source, iterator, operato))
+		return false;
+
+	iterator++;
+	return true;
+}
+
+//span from the current token to the end of the last token of the line, comments and trailing whitespaces excluded
+inline string_view get_rest_of_line(const tokenized_source& source, size_t& iterator)
+{
+	size_t begin = source.at(iterator).begin;
+	size_t end = begin;
+
+	while (!is_at_line_end(source, iterator))
+		end = source.at(iterator++).end;
+
+	return { source.source, begin, end };
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+//Pair : library name + library pointer
+using named_library = std::pair<std::string, std::shared_ptr<parsed_library>>;
+//Pair : symbol name + symbol_definition
+using named_symbol = std::pair<std::string, symbol_definition>;
+
+/*
+	scope_entity is the thing a name refers to in some scope
+	- type : entity type
+	- value : pointer to the named entity (eg. named_variable*), owned by the collection the entity is stored in
+*/
+struct scope_entity
+{
+public:
+	enum class entity_type
+	{
+		variable,
+		parameter,
+		function,
+		library,
+		symbol
+	};
+
+private:
+	entity_type type;
+	void* value;
+
+public:
+	scope_entity(entity_type _type, void* ptr) : type(_type), value(ptr) {};
+
+	inline entity_type get_type() const noexcept
+	{
+		return type;
+	};
+
+	//Used in the errors, eg. "Variable named: a already exists"
+	inline const char* get_display_name() const
+	{
+		switch (type)
+		{
+		case entity_type::variable:		return "Variable";
+		case entity_type::parameter:	return "Parameter";
+		case entity_type::function:		return "Function";
+		case entity_type::library:		return "Library";
+		case entity_type::symbol:		return "Symbol";
+		}
+		return "";
+	}
+
+	static inline scope_entity new_variable(const named_variable* variable)
+	{return { entity_type::variable, const_cast<named_variable*>(variable) };}
+
+	static inline scope_entity new_parameter(const named_parameter* parameter)
+	{return { entity_type::parameter, const_cast<named_parameter*>(parameter) };}
+
+	static inline scope_entity new_function(const named_function* function)
+	{return { entity_type::function, const_cast<named_function*>(function) };}
+
+	static inline scope_entity new_library(const named_library* library)
+	{return { entity_type::library, const_cast<named_library*>(library) };}
+
+	static inline scope_entity new_symbol(const named_symbol* symbol)
+	{return { entity_type::symbol, const_cast<named_symbol*>(symbol) };}
+
+	inline named_variable* as_variable() const
+	{return reinterpret_cast<named_variable*>(value);}
+
+	inline named_parameter* as_parameter() const
+	{return reinterpret_cast<named_parameter*>(value);}
+
+	inline named_function* as_function() const
+	{return reinterpret_cast<named_function*>(value);}
+
+	inline named_library* as_library() const
+	{return reinterpret_cast<named_library*>(value);}
+
+	inline named_symbol* as_symbol() const
+	{return reinterpret_cast<named_symbol*>(value);}
+};
+
+/*
+	names_scope maps names to the entities they refer to, so any name is resolved with a single lookup per scope
+	scopes are nested: function's scope -> material's or library's scope -> context's scope (common functions)
+	names have to be unique in the whole chain of scopes, but variables and parameters are not accessible from the nested scopes
+	(matl functions cannot use material's variables or parameters)
+	- parent : enclosing scope, nullptr for the outermost one
+	- values_allowed : whether variables and parameters can be used in expressions parsed in this scope
+*/
+class names_scope
+{
+	heterogeneous_map<std::string, scope_entity, hgm_string_solver> names;
+	const names_scope* parent = nullptr;
+	bool values_allowed = true;
+
+public:
+	names_scope() {};
+	names_scope(const names_scope* _parent, bool _values_allowed)
+		: parent(_parent), values_allowed(_values_allowed) {};
+
+	inline bool allows_values() const
+	{
+		return values_allowed;
+	}
+
+	inline void set_parent(const names_scope* _parent)
+	{
+		parent = _parent;
+	}
+
+	//removes all names, used when the scope is reused for the next function
+	inline void clear()
+	{
+		names.clear();
+	}
+
+	//binds the name to the entity; if the name is already bound in this scope the previous entity is kept
+	template<class _key2>
+	inline void declare(const _key2& name, scope_entity entity)
+	{
+		if (names.find(name) == names.end())
+			names.insert({ std::string(name), entity });
+	}
+
+	//returns the entity bound to the name in this scope or in any enclosing one, nullptr if there is none
+	template<class _key2>
+	inline const scope_entity* find_declared(const _key2& name) const
+	{
+		for (auto scope = this; scope != nullptr; scope = scope->parent)
+		{
+			auto itr = scope->names.find(name);
+			if (itr != scope->names.end()) return &itr->second;
+		}
+		return nullptr;
+	}
+
+	//same as find_declared, but skips variables and parameters of the enclosing scopes, since they are not accessible here
+	template<class _key2>
+	inline const scope_entity* find(const _key2& name) const
+	{
+		using entity_type = scope_entity::entity_type;
+
+		for (auto scope = this; scope != nullptr; scope = scope->parent)
+		{
+			auto itr = scope->names.find(name);
+			if (itr == scope->names.end()) continue;
+
+			auto type = itr->second.get_type();
+			if (scope != this && (type == entity_type::variable || type == entity_type::parameter))
+				return nullptr;
+
+			return &itr->second;
+		}
+		return nullptr;
+	}
+};
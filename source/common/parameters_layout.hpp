@@ -0,0 +1,106 @@
+#pragma once
+
+enum class parameters_layout_type
+{
+	separate,	//each parameter declared on it's own
+	block,		//non-texture parameters packed into a single std140 block
+	buffer		//non-texture parameters packed into a struct, stored in an array inside std430 storage buffer
+};
+
+/*
+	Layout of the parameters packed into a single block (eg. glsl's uniform block)
+	- members : parameters placed inside the block, in the order they should be declared
+	- offsets : byte offset of each member, offsets.at(i) is offset of members.at(i)
+	- size : size of the whole block in bytes; for buffer layout it is the stride of the array element
+	Textures are never a part of the block, since they cannot be stored inside buffers
+	Layout is generated by get_parameters_block_layout(...)
+*/
+struct parameters_block_layout
+{
+	std::vector<const named_parameter*> members;
+	std::vector<uint32_t> offsets;
+	uint32_t size = 0;
+};
+
+//std140 base alignment of the type
+inline uint32_t get_std140_alignment(const data_type* type)
+{
+	switch (get_vector_size(type))
+	{
+	case 2: return 8;
+	case 3:
+	case 4: return 16;
+	}
+
+	return 4;
+}
+
+//std140 size of the type
+inline uint32_t get_std140_size(const data_type* type)
+{
+	auto size = get_vector_size(type);
+	return size == 0 ? 4 : 4 * size;
+}
+
+//generates std140 (block) or std430 (buffer) compatible layout of the parameters
+//both layouts place members the same way, they only differ in the size of the whole block
+//members are sorted to minimize padding: vector4s first, then vector3s each followed by a scalar, then vector2s and the rest of scalars
+inline parameters_block_layout get_parameters_block_layout(const parameters_collection& parameters, parameters_layout_type type)
+{
+	std::vector<const named_parameter*> vectors4;
+	std::vector<const named_parameter*> vectors3;
+	std::vector<const named_parameter*> vectors2;
+	std::vector<const named_parameter*> scalars;
+
+	for (auto& param : parameters)
+	{
+		if (param.second.type == texture_data_type) continue;
+
+		switch (get_vector_size(param.second.type))
+		{
+		case 4: vectors4.push_back(&param); break;
+		case 3: vectors3.push_back(&param); break;
+		case 2: vectors2.push_back(&param); break;
+		default: scalars.push_back(&param); break;
+		}
+	}
+
+	parameters_block_layout layout;
+	uint32_t max_alignment = 4;
+
+	auto place = [&](const named_parameter* param)
+	{
+		auto alignment = get_std140_alignment(param->second.type);
+		layout.size = (layout.size + alignment - 1) / alignment * alignment;
+		max_alignment = std::max(max_alignment, alignment);
+
+		layout.members.push_back(param);
+		layout.offsets.push_back(layout.size);
+
+		layout.size += get_std140_size(param->second.type);
+	};
+
+	auto scalars_itr = scalars.begin();
+
+	for (auto& param : vectors4)
+		place(param);
+
+	for (auto& param : vectors3)
+	{
+		place(param);
+		if (scalars_itr != scalars.end())
+			place(*scalars_itr++);
+	}
+
+	for (auto& param : vectors2)
+		place(param);
+
+	while (scalars_itr != scalars.end())
+		place(*scalars_itr++);
+
+	//uniform blocks are allocated in vector4 units, std430 array elements are aligned to their largest member
+	uint32_t size_alignment = type == parameters_layout_type::buffer ? max_alignment : 16;
+	layout.size = (layout.size + size_alignment - 1) / size_alignment * size_alignment;
+
+	return layout;
+}
@@ -1,44 +1,53 @@
 #pragma once
 
+using source_view = matl::source_view;
+
 struct string_view
 {
 	friend bool operator==(const string_view& ref, const std::string& other);
 
 private:
-	const std::string* source;
+	const char* source;
+	size_t source_size;
 
 public:
 	size_t begin;
 	size_t end;
 
-	string_view(std::nullptr_t) : source(nullptr), begin(0), end(0) {};
+	string_view(std::nullptr_t) : source(nullptr), source_size(0), begin(0), end(0) {};
+
+	string_view(const source_view& _source, size_t _begin, size_t _end)
+		: source(_source.data()), source_size(_source.size()), begin(_begin), end(_end) {};
 
 	string_view(const std::string& _source, size_t _begin, size_t _end)
-		: source(&_source), begin(_begin), end(_end) {};
+		: source(_source.data()), source_size(_source.size()), begin(_begin), end(_end) {};
 
 	string_view(const std::string& _source)
-		: source(&_source), begin(0), end(_source.size()) {};
+		: source(_source.data()), source_size(_source.size()), begin(0), end(_source.size()) {};
 
 	operator std::string() const
 	{
-		return source->substr(begin, end - begin);
+		return std::string(source + begin, end - begin);
 	}
 
-	void operator= (const string_view& other)
-	{
-		source = other.source;
-		begin = other.begin;
-		end = other.end;
-	}
+	string_view(const string_view& other) = default;
+	string_view& operator= (const string_view& other) = default;
 
 	size_t size() const
 	{
 		return end - begin;
 	}
 
+	//same as source's at, so it may read past the view, but never past the source
 	const char& at(size_t id) const
 	{
-		return source->at(begin + id);
+		if (begin + id >= source_size) throw std::out_of_range("string_view::at");
+		return source[begin + id];
+	}
+
+	const char* data() const
+	{
+		return source + begin;
 	}
 };
 
@@ -46,11 +55,7 @@ inline bool operator==(const string_view& ref, const std::string& other)
 {
 	if (ref.size() != other.size()) return false;
 
-	for (size_t i = 0; i < other.size(); i++)
-		if (ref.source->at(i + ref.begin) != other.at(i))
-			return false;
-
-	return true;
+	return std::equal(other.begin(), other.end(), ref.source + ref.begin);
 }
 
 inline bool operator == (const std::string& other, const string_view& q)
@@ -63,44 +68,75 @@ inline bool operator == (const string_view& q, const string_view& p)
 	return q.begin == p.begin && q.end == p.end;
 }
 
+/*
+	Classes of the characters, looked up in a single table instead of comparing the character with each of the class members
+	- digit : 0-9
+	- operator : characters that should end a string_ref (not only matl operators)
+	- whitespace : space, tab, new line and null
+	- token_end : operator or whitespace
+*/
+namespace char_class
+{
+	constexpr uint8_t digit = 1;
+	constexpr uint8_t operato = 2;
+	constexpr uint8_t whitespace = 4;
+	constexpr uint8_t token_end = 8;
+}
+
+struct char_classes_table
+{
+	uint8_t classes[256] = {};
+
+	constexpr char_classes_table()
+	{
+		for (char c = '0'; c <= '9'; c++)
+			classes[static_cast<uint8_t>(c)] |= char_class::digit;
+
+		for (const char* c = "+-*/^=><!)(.,#:\"$&'?@][`~"; *c != '\0'; c++)
+			classes[static_cast<uint8_t>(*c)] |= char_class::operato | char_class::token_end;
+
+		for (const char* c = " \t\n"; *c != '\0'; c++)
+			classes[static_cast<uint8_t>(*c)] |= char_class::whitespace | char_class::token_end;
+
+		classes[0] |= char_class::whitespace | char_class::token_end;
+	}
+
+	inline bool is(const char& c, uint8_t char_class) const
+	{
+		return (classes[static_cast<uint8_t>(c)] & char_class) != 0;
+	}
+};
+
+constexpr char_classes_table char_classes;
+
 inline bool is_digit(const char& c)
 {
-	return (c >= '0' && c <= '9');
+	return char_classes.is(c, char_class::digit);
 }
 
 //does not check if char is a matl operator
 //insted checks if char is one of the characters that should end a string_ref
 inline bool is_operator(const char& c)
 {
-	return (c == '+' || c == '-' || c == '*' || c == '/' || c == '^' || c == '='
-		|| c == '>' || c == '<' || c == '!'
-		|| c == ')' || c == '(' || c == '.' || c == ','
-		|| c == '#' || c == ':'
-		|| c == '"' || c == '$' || c == '&' || c == '\'' || c == '?'
-		|| c == '>' || c == '<' || c == '@' || c == ']' || c == '[' || c == ']' || c == '`' || c == '~');
+	return char_classes.is(c, char_class::operato);
 }
 
 inline bool is_whitespace(const char& c)
 {
-	return (c == ' ' || c == '\t' || c == '\0' || c == '\n');
+	return char_classes.is(c, char_class::whitespace);
 }
 
-inline bool is_at_source_end(const std::string& source, const size_t& iterator)
+inline bool is_at_source_end(const source_view& source, const size_t& iterator)
 {
-	return (iterator >= source.size() || source.at(iterator) == '\0');
+	return (iterator >= source.size() || source[iterator] == '\0');
 };
 
-inline bool is_at_line_end(const std::string& source, const size_t& iterator)
+inline bool is_at_line_end(const source_view& source, const size_t& iterator)
 {
-	return (is_at_source_end(source, iterator) || source.at(iterator) == '\n');
+	return (is_at_source_end(source, iterator) || source[iterator] == '\n');
 };
 
-inline const char& get_char(const std::string& source, size_t& iterator)
-{
-	return source.at(iterator++);
-}
-
-inline void get_to_char(char target, const std::string& source, size_t& iterator)
+inline void get_to_char(char target, const source_view& source, size_t& iterator)
 {
 	while (source.at(iterator) != target)
 	{
@@ -110,28 +146,102 @@ inline void get_to_char(char target, const std::string& source, size_t& iterator
 	}
 }
 
-inline void get_to_char_while_counting_lines(char target, const std::string& source, size_t& iterator, int& line_counter, bool& whitespaces_only)
+#ifdef MATL_SSE2
+inline int count_set_bits(uint32_t mask)
+{
+	int count = 0;
+
+	while (mask != 0)
+	{
+		mask &= mask - 1;
+		count++;
+	}
+
+	return count;
+}
+#endif
+
+inline void get_to_char_while_counting_lines(char target, const source_view& source, size_t& iterator, int& line_counter, bool& whitespaces_only)
 {
 	whitespaces_only = true;
 
-	while (source.at(iterator) != target)
+	if (source.at(iterator) == target) return;
+
+	if (source[iterator] == '\n') line_counter++;
+	else if (!is_whitespace(source[iterator])) whitespaces_only = false;
+
+	iterator++;
+	if (is_at_source_end(source, iterator))
+		return;
+
+	const size_t size = source.size();
+
+#ifdef MATL_SSE2
+	//scan 16 bytes at once; stops at the target or at the '\0' that ends the source
+	const __m128i target_vector = _mm_set1_epi8(target);
+	const __m128i zero_vector = _mm_setzero_si128();
+	const __m128i new_line_vector = _mm_set1_epi8('\n');
+	const __m128i space_vector = _mm_set1_epi8(' ');
+	const __m128i tab_vector = _mm_set1_epi8('\t');
+
+	while (iterator + 16 <= size)
 	{
-		if (source.at(iterator) == '\n') line_counter++;
-		else if (!is_whitespace(source.at(iterator))) whitespaces_only = false;
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source.data() + iterator));
+
+		const uint32_t stop_mask = _mm_movemask_epi8(_mm_or_si128(
+			_mm_cmpeq_epi8(chunk, target_vector),
+			_mm_cmpeq_epi8(chunk, zero_vector)
+		));
+		const uint32_t new_lines_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, new_line_vector));
+
+		uint32_t scanned_mask = 0xFFFF;
+		int scanned_bytes = 16;
+
+		if (stop_mask != 0)
+		{
+			scanned_bytes = 0;
+			while (((stop_mask >> scanned_bytes) & 1) == 0) scanned_bytes++;
+			scanned_mask = (1u << scanned_bytes) - 1;
+		}
+
+		line_counter += count_set_bits(new_lines_mask & scanned_mask);
+
+		if (whitespaces_only)
+		{
+			const uint32_t whitespaces_mask = _mm_movemask_epi8(_mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, space_vector), _mm_cmpeq_epi8(chunk, tab_vector)),
+				_mm_cmpeq_epi8(chunk, new_line_vector)
+			));
+
+			if ((~whitespaces_mask & scanned_mask) != 0)
+				whitespaces_only = false;
+		}
+
+		iterator += scanned_bytes;
+		if (stop_mask != 0) return;
+	}
+#endif
+
+	while (iterator < size)
+	{
+		const char c = source[iterator];
+
+		if (c == target || c == '\0') return;
+
+		if (c == '\n') line_counter++;
+		else if (!is_whitespace(c)) whitespaces_only = false;
 
 		iterator++;
-		if (is_at_source_end(source, iterator))
-			return;
 	}
 }
 
-inline int get_spaces(const std::string& source, size_t& iterator)
+inline int get_spaces(const source_view& source, size_t& iterator)
 {
 	int spaces = 0;
 
-	while (true)
+	while (!is_at_source_end(source, iterator))
 	{
-		const char& c = source.at(iterator);
+		const char& c = source[iterator];
 
 		if (c == ' ')
 			spaces++;
@@ -140,24 +250,18 @@ inline int get_spaces(const std::string& source, size_t& iterator)
 		else
 			break;
 
-		iterator++; if (iterator == source.size()) break;
+		iterator++;
 	}
 
 	return spaces;
 }
 
-inline string_view get_string_ref(const std::string& source, size_t& iterator, std::string& error)
+inline string_view get_string_ref(const source_view& source, size_t& iterator, std::string& error)
 {
 	size_t begin = iterator;
 
-	while (true)
-	{
-		const char& c = source.at(iterator);
-
-		if (is_operator(c) || is_whitespace(c)) break;
-
-		iterator++; if (iterator == source.size()) break;
-	}
+	while (iterator < source.size() && !char_classes.is(source[iterator], char_class::token_end))
+		iterator++;
 
 	if (iterator == begin)
 	{
@@ -177,26 +281,3 @@ inline string_view get_string_ref(const std::string& source, size_t& iterator, s
 }
 
 extern const char comment_char;
-
-inline string_view get_rest_of_line(const std::string& source, size_t& iterator)
-{
-	size_t begin = iterator;
-
-	while (!is_at_line_end(source, iterator) && source.at(iterator) != comment_char)
-		iterator++;
-
-	if (!is_at_line_end(source, iterator) && source.at(iterator) == comment_char)
-		iterator -= 1;
-
-	while (is_whitespace(source.at(iterator - 1)))
-		iterator--;
-
-	return { source, begin, iterator };
-}
-
-inline void get_to_new_line(const std::string& source, size_t& iterator)
-{
-	while (!is_at_line_end(source, iterator))
-		iterator++;
-	iterator++;
-}
\ No newline at end of file
@@ -9,21 +9,27 @@ struct parameter_definition;
 struct function_definition;
 struct function_instance;
 struct symbol_definition;
+struct translator;
 
 const data_type* const get_data_type(const string_view& name);
+size_t get_data_types_count();
 const unary_operator_definition* const get_unary_operator(const string_view& symbol);
 const binary_operator_definition* const get_binary_operator(const string_view& symbol);
 
 /*
 	Matl data type like scalar or vector
+	- id : index of the type in data_types; used to index operators returned types tables
 	- name : type name
+	- vector_size : ammount of components of scalar and vector types, 0 for other types
 	Concrete data types are definied in source/version/types.hpp
 */
 struct data_type
 {
+	uint8_t id;
 	std::string name;
-	data_type(std::string _name)
-		: name(_name) {};
+	uint8_t vector_size;
+	data_type(uint8_t _id, std::string _name, uint8_t _vector_size)
+		: id(_id), name(_name), vector_size(_vector_size) {};
 };
 
 /*
@@ -32,6 +38,7 @@ struct data_type
 	precedence : operator's precedence value
 	operation_display_name : name of operation used in error messages
 	allowed_types : set types for which the operator is valid, eg. negation is valid for scalar but not texture. Also contains information about the type returned for given operands types
+	returned_types : allowed_types indexed by the operand type id; nullptr for not allowed types
 	Concrete operators are definied in source/version/operators.hpp
 */
 struct unary_operator_definition
@@ -43,13 +50,19 @@ struct unary_operator_definition
 	struct valid_types_set;
 	std::vector<valid_types_set> allowed_types;
 
+	std::vector<const data_type*> returned_types;
+
 	unary_operator_definition(
 		std::string _symbol,
 		std::string _operation_display_name,
 		uint8_t _precedence,
-		std::vector<valid_types_set> _allowed_types)
-		: symbol(_symbol), operation_display_name(_operation_display_name),
-		precedence(_precedence), allowed_types(_allowed_types) {};
+		std::vector<valid_types_set> _allowed_types);
+
+	//returns nullptr if the operator is not valid for the type
+	inline const data_type* get_returned_type(const data_type* operand) const
+	{
+		return returned_types[operand->id];
+	}
 };
 
 /*
@@ -75,6 +88,7 @@ struct unary_operator_definition::valid_types_set
 	- precedence : operator's precedence value
 	- operation_display_name : name of operation used in error messages
 	- allowed_types : set types for which the operator is valid, eg. addition is valid for scalar + scalar but not for vector2 + vector3. Also contains information about the type returned for given operands types
+	- returned_types : allowed_types indexed by [left operand type id][right operand type id]; nullptr for not allowed types
 	Concrete operators are definied in source/version/operators.hpp
 */
 struct binary_operator_definition
@@ -86,13 +100,20 @@ struct binary_operator_definition
 	struct valid_types_set;
 	std::vector<valid_types_set> allowed_types;
 
+	size_t types_count;
+	std::vector<const data_type*> returned_types;
+
 	binary_operator_definition(
 		std::string _symbol,
 		std::string _operation_display_name,
 		uint8_t _precedence,
-		std::vector<valid_types_set> _allowed_types)
-		: symbol(_symbol), operation_display_name(_operation_display_name),
-		precedence(_precedence), allowed_types(_allowed_types) {};
+		std::vector<valid_types_set> _allowed_types);
+
+	//returns nullptr if the operator is not valid for the types
+	inline const data_type* get_returned_type(const data_type* left, const data_type* right) const
+	{
+		return returned_types[left->id * types_count + right->id];
+	}
 };
 
 /*
@@ -116,6 +137,34 @@ struct binary_operator_definition::valid_types_set
 		returned_type(get_data_type(_returned_type)) {};
 };
 
+unary_operator_definition::unary_operator_definition(
+	std::string _symbol,
+	std::string _operation_display_name,
+	uint8_t _precedence,
+	std::vector<valid_types_set> _allowed_types)
+	: symbol(_symbol), operation_display_name(_operation_display_name),
+	precedence(_precedence), allowed_types(_allowed_types)
+{
+	returned_types.resize(get_data_types_count(), nullptr);
+
+	for (auto& at : allowed_types)
+		returned_types.at(at.operand_type->id) = at.returned_type;
+};
+
+binary_operator_definition::binary_operator_definition(
+	std::string _symbol,
+	std::string _operation_display_name,
+	uint8_t _precedence,
+	std::vector<valid_types_set> _allowed_types)
+	: symbol(_symbol), operation_display_name(_operation_display_name),
+	precedence(_precedence), allowed_types(_allowed_types), types_count(get_data_types_count())
+{
+	returned_types.resize(types_count * types_count, nullptr);
+
+	for (auto& at : allowed_types)
+		returned_types.at(at.left_operand_type->id * types_count + at.right_operand_type->id) = at.returned_type;
+};
+
 //Pair : variable name + variable_definition
 using named_variable = std::pair<std::string, variable_definition>;
 //Pair : parameter name + parameter_definition
@@ -137,6 +186,7 @@ using named_function = std::pair<std::string, function_definition>;
 	- used_functions : list of functions instances used by expressions, important when deciding whether to put the function into the result shader
 	Expressions are generated by get_expression(...) definied in source/common/expression_parsing.hpp
 	Their type correctness is validated by the validate_expression(...) definied in the same file as get_expression(...)
+	or, if get_expression(...) is given a pointer for the type, while they are parsed
 */
 struct expression
 {
@@ -169,7 +219,8 @@ struct expression
 	//list of variables used by expression, important when deciding whether to put the variable into the result shader
 	std::vector<named_variable*> used_variables;
 
-	//list of functions instances used by expressions, important when deciding whether to put the function into the result shader
+	//tables of functions instances called by the expression, in the order of the calls; important when deciding whether to put the function into the result shader
+	//expressions inside functions have one table per function instance (indexed like function_definition::instances), other expressions have a single one
 	std::vector<std::vector<function_instance*>> used_functions;
 
 	expression(
@@ -310,6 +361,14 @@ public:
 
 	inline std::shared_ptr<parsed_library>& as_library() const
 	{return *reinterpret_cast<std::shared_ptr<parsed_library>*>(value);}
+
+
+	//Used when the material is rebound to another domain
+	inline void set_symbol(const symbol_definition* symbol)
+	{value = const_cast<symbol_definition*>(symbol);}
+
+	inline void set_function(const named_function* function)
+	{value = const_cast<named_function*>(function);}
 };
 
 expression::single_expression::~single_expression()
@@ -322,6 +381,8 @@ expression::single_expression::~single_expression()
 	variable_definition
 	- type : variable type
 	- definition_line : line at which variable was definied
+	- index : position of the variable among the material's variables, which is also their definition order; unused for functions variables
+	- deferred : whether the variable validation is deferred until some property uses it, type is not known until then
 	created every time variable is created, stored in material or function
 */
 struct variable_definition
@@ -330,6 +391,9 @@ struct variable_definition
 
 	expression* value;
 	unsigned int definition_line = 0;
+	uint32_t index = 0;
+
+	bool deferred = false;
 
 	~variable_definition() { delete value; }
 };
@@ -364,7 +428,8 @@ using parameters_collection = heterogeneous_map<std::string, parameter_definitio
 	- function_native_name : explained below
 	- returned_type : function returned value type
 	- arguments_types : function's arguments types indeed
-	- translated : cached function translation
+	- called_instances : instances of other functions called by this instance's body, directly or not
+	- translated : cached function translation, separate for every target language
 	functions instances are generated by instatiate_function(...) definied in source/common/expressions_parsing.hpp
 */ 
 struct function_instance
@@ -387,8 +452,12 @@ struct function_instance
 	//function's arguments types indeed
 	std::vector<const data_type*> arguments_types;
 
-	//cache translated function for future parse_material calls
-	std::string translated;
+	//instances of other functions called by this instance's body, directly or not, each one once; callees precede their callers
+	//computed when the instance is created, calls of the body's expressions are resolved by their per-instance tables (see expression::used_functions)
+	std::vector<function_instance*> called_instances;
+
+	//cache translated function for future parse_material calls, per translator
+	std::unordered_map<const translator*, std::string> translated;
 
 	bool args_matching(const std::vector<const data_type*>& args) const
 	{
@@ -401,6 +470,106 @@ struct function_instance
 	function_instance(function_definition* _function) : function(_function) {};
 };
 
+//packs the arguments types ids into a single value, used to index functions instances
+//exact for any realistic amount of arguments; colliding signatures are told apart by comparing the types
+template<class _iterator>
+inline size_t get_arguments_signature(_iterator begin, _iterator end)
+{
+	const size_t base = get_data_types_count() + 1;
+
+	size_t signature = 0;
+	for (auto itr = begin; itr != end; itr++)
+		signature = signature * base + (*itr == nullptr ? 0 : (*itr)->id + 1);
+
+	return signature;
+}
+
+/*
+	function_instances_collection stores instances of a function, indexed by their arguments signature (see get_arguments_signature)
+	so the instance matching a call is found with a single hashed lookup, regardless of how many instances the function has
+	instances are stored in a list, so pointers to them stay valid
+*/
+class function_instances_collection
+{
+	std::list<function_instance> instances;
+	std::unordered_multimap<size_t, function_instance*> index;
+
+	inline void build_index()
+	{
+		index.clear();
+		for (auto& instance : instances)
+			if (find(instance.arguments_types) == nullptr)
+				index.insert({ get_arguments_signature(instance.arguments_types.begin(), instance.arguments_types.end()), &instance });
+	}
+
+public:
+	using iterator = std::list<function_instance>::iterator;
+	using const_iterator = std::list<function_instance>::const_iterator;
+
+	function_instances_collection() {};
+
+	//the index holds pointers to the instances, so it must be rebuilt for the copied list
+	function_instances_collection(const function_instances_collection& other)
+		: instances(other.instances)
+	{
+		build_index();
+	};
+
+	function_instances_collection(function_instances_collection&& other) = default;
+
+	function_instances_collection& operator=(const function_instances_collection& other)
+	{
+		instances = other.instances;
+		build_index();
+		return *this;
+	};
+
+	function_instances_collection& operator=(function_instances_collection&& other) = default;
+
+	inline iterator begin() { return instances.begin(); }
+	inline iterator end() { return instances.end(); }
+	inline const_iterator begin() const { return instances.begin(); }
+	inline const_iterator end() const { return instances.end(); }
+
+	inline size_t size() const { return instances.size(); }
+
+	inline function_instance& back() { return instances.back(); }
+	inline const function_instance& back() const { return instances.back(); }
+
+	//adds an instance for given arguments types
+	//if there already is an instance for the same types, the new one is stored but calls keep resolving to the first one
+	inline function_instance& add(function_definition* function, std::vector<const data_type*> arguments_types)
+	{
+		instances.push_back({ function });
+		auto& instance = instances.back();
+		instance.arguments_types = std::move(arguments_types);
+
+		if (find(instance.arguments_types) == nullptr)
+			index.insert({ get_arguments_signature(instance.arguments_types.begin(), instance.arguments_types.end()), &instance });
+
+		return instance;
+	}
+
+	//returns the instance for the arguments types in range [begin, end), nullptr if the function is not instantiated for them
+	template<class _iterator>
+	inline function_instance* find(_iterator begin, _iterator end) const
+	{
+		auto range = index.equal_range(get_arguments_signature(begin, end));
+		for (auto itr = range.first; itr != range.second; itr++)
+		{
+			auto& types = itr->second->arguments_types;
+			if (std::equal(types.begin(), types.end(), begin, end))
+				return itr->second;
+		}
+		return nullptr;
+	}
+
+	inline function_instance* find(const std::vector<const data_type*>& arguments_types) const
+	{
+		return find(arguments_types.begin(), arguments_types.end());
+	}
+};
+
 struct parsed_library;
 
 /*
@@ -434,9 +603,15 @@ struct function_definition
 	variables_collection variables;
 
 	//the expression after return keyword
-	expression* returned_value;
+	expression* returned_value = nullptr;
 
-	std::list<function_instance> instances;
+	function_instances_collection instances;
+
+	//whether the body is not parsed yet; set for functions of libraries parsed lazily, body is parsed on the first use
+	bool lazy_body = false;
+
+	//index of the line_begin token of the body's first line, in the library tokens
+	size_t lazy_body_begin = 0;
 
 	~function_definition() { delete returned_value; };
 };
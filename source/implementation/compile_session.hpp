@@ -0,0 +1,38 @@
+#pragma once
+
+struct matl::compile_session::implementation
+{
+	context_public_implementation* context = nullptr;
+
+	//kept between the materials, so their containers reuse memory
+	material_parsing_state state;
+	tokenized_source tokens;
+	translation_buffers buffers;
+};
+
+matl::compile_session::compile_session(matl::context* context)
+{
+	impl = std::make_shared<implementation>();
+
+	if (context != nullptr)
+		impl->context = &context->impl->impl;
+}
+
+matl::parsed_material matl::compile_session::parse_material(const std::string& material_source)
+{
+	return parse_material(source_view(material_source));
+}
+
+matl::parsed_material matl::compile_session::parse_material(const source_view& material_source)
+{
+	auto& state = impl->state;
+	state.reset();
+
+	parsed_material failure;
+
+	if (!parse_material_state(material_source, impl->context, state, failure, &impl->tokens))
+		return failure;
+
+	auto& context_impl = *impl->context;
+	return translate_material(state, context_impl, context_impl._translator, nullptr, &impl->buffers);
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+struct matl::compiled_material::implementation
+{
+	material_parsing_state state;
+	context_public_implementation* context;
+
+	//domain specified by the material itself; expressions are bound to it between the emissions
+	std::shared_ptr<const parsed_domain> material_domain;
+
+	//reachability of the material's variables, built once; used to find the expressions emitted for a domain
+	variables_reachability reachability;
+
+	//expressions rebound to the domain of the current emission
+	std::vector<expression*> rebound;
+};
+
+//properties of the domain specified by the material, and the variables they use; the only expressions emitted for the domain
+//fallbacks : properties replaced with the domain's fallbacks, their material's values are not emitted; nullptr if none
+inline void get_domain_expressions(
+	material_parsing_state& state,
+	variables_reachability& reachability,
+	const parsed_domain& domain,
+	const std::list<std::string>* fallbacks,
+	std::vector<expression*>& expressions
+)
+{
+	expressions.clear();
+	std::vector<uint64_t> used(reachability.words, 0);
+
+	for (auto& prop : domain.properties)
+	{
+		auto itr = state.properties.find(prop.first);
+		if (itr == state.properties.end()) continue;
+		if (fallbacks != nullptr && std::find(fallbacks->begin(), fallbacks->end(), prop.first) != fallbacks->end()) continue;
+
+		expressions.push_back(itr->second.value);
+
+		auto& row = get_property_reachability(reachability, itr->second.value);
+		for (size_t word = 0; word < reachability.words; word++)
+			used[word] |= row[word];
+	}
+
+	for (size_t index = 0; index < reachability.variables.size(); index++)
+		if (is_variable_reachable(used, index) && reachability.variables[index]->second.value != nullptr)
+			expressions.push_back(reachability.variables[index]->second.value);
+}
+
+/*
+	Rebinds material's expressions from the domain it currently uses to another, compatible one
+	Domains are compatible if the new domain's properties are specified by the material with the same types,
+	and symbols and exposed functions used by the material exist in the new domain with the same types
+	Matl functions cannot access the domain, so only material's variables and properties are rebound
+	Nothing is changed if domains are not compatible
+	material_domain : domain the material was parsed with, properties types are validated against it
+	expressions : expressions emitted for the new domain (see get_domain_expressions); variables that are not emitted may use
+		symbols the new domain does not expose, so they are neither checked nor rebound
+*/
+void rebind_material_domain(
+	material_parsing_state& state, 
+	const parsed_domain& material_domain, 
+	const std::shared_ptr<const parsed_domain>& domain, 
+	const std::vector<expression*>& expressions,
+	std::string& error
+)
+{
+	using node_type = expression::node::node_type;
+
+	auto& previous = *state.domain;
+
+	for (auto& prop : domain->properties)
+	{
+		throw_error(state.properties.find(prop.first) == state.properties.end(),
+			"Material does not specify property: " + prop.first);
+
+		auto material_prop = material_domain.properties.find(prop.first);
+		throw_error(material_prop->second != prop.second,
+			"Property " + prop.first + " has different type in the domains");
+	}
+
+	std::unordered_map<const symbol_definition*, const symbol_definition*> symbols;
+	for (auto& symbol : previous.symbols)
+	{
+		auto itr = domain->symbols.find(symbol.first);
+		bool compatible = itr != domain->symbols.end() && itr->second.type == symbol.second.type;
+		symbols.insert({ &symbol.second, compatible ? &itr->second : nullptr });
+	}
+
+	std::unordered_map<const function_definition*, const named_function*> functions;
+	for (auto& func : previous.functions)
+	{
+		auto itr = domain->functions.find(func.first);
+		functions.insert({ &func.second, itr != domain->functions.end() ? &*itr : nullptr });
+	}
+
+	auto get_instance = [&](const function_instance* instance) -> function_instance*
+	{
+		auto& function = functions.at(instance->function);
+		if (function == nullptr) return nullptr;
+
+		for (auto& new_instance : const_cast<named_function*>(function)->second.instances)
+			if (new_instance.args_matching(instance->arguments_types) && new_instance.returned_type == instance->returned_type)
+				return &new_instance;
+
+		return nullptr;
+	};
+
+	//first pass only checks if the domains are compatible, second one applies the changes
+	auto rebind_expression = [&](expression* exp, bool apply)
+	{
+		for (auto& exp_case : exp->cases)
+			for (auto& single : { exp_case->condition, exp_case->value })
+			{
+				if (single == nullptr) continue;
+
+				for (auto& node : single->nodes)
+				{
+					if (node->get_type() == node_type::symbol)
+					{
+						auto new_symbol = symbols.at(node->as_symbol());
+						if (new_symbol == nullptr)
+						{
+							for (auto& symbol : previous.symbols)
+								if (&symbol.second == node->as_symbol())
+									error = "Domain does not expose symbol: " + symbol.first;
+							return;
+						}
+						if (apply) node->set_symbol(new_symbol);
+					}
+					else if (node->get_type() == node_type::function && functions.find(&node->as_function()->second) != functions.end())
+					{
+						auto new_function = functions.at(&node->as_function()->second);
+						throw_error(new_function == nullptr, "Domain does not expose function: " + node->as_function()->first);
+						if (apply) node->set_function(new_function);
+					}
+				}
+			}
+
+		for (auto& table : exp->used_functions)
+			for (auto& instance : table)
+			{
+				if (functions.find(instance->function) == functions.end()) continue;
+
+				auto new_instance = get_instance(instance);
+				throw_error(new_instance == nullptr, "Domain does not expose matching instance of function: " + *instance->function->function_name_ptr);
+				if (apply) instance = new_instance;
+			}
+	};
+
+	for (bool apply : { false, true })
+		for (auto& exp : expressions)
+		{
+			rebind_expression(exp, apply);
+			rethrow_error();
+		}
+
+	state.domain = domain;
+}
+
+matl::compiled_material matl::compile_material(const std::string& material_source, matl::context* context)
+{
+	compiled_material material;
+
+	auto impl = std::make_shared<compiled_material::implementation>();
+	parsed_material failure;
+
+	if (!parse_material_state(material_source, context == nullptr ? nullptr : &context->impl->impl, impl->state, failure))
+	{
+		material.errors = std::move(failure.errors);
+		return material;
+	}
+
+	impl->context = &context->impl->impl;
+	impl->material_domain = impl->state.domain;
+	build_variables_reachability(impl->state.variables, impl->reachability);
+
+	material.impl = std::move(impl);
+	material.success = true;
+	return material;
+}
+
+matl::parsed_material matl::compiled_material::emit(const std::string& domain_override, const emit_options& options)
+{
+	if (impl == nullptr)
+	{
+		parsed_material material;
+		material.errors = { "[0] Cannot emit material that failed to compile" };
+		return material;
+	}
+
+	auto& state = impl->state;
+
+	const translator* translator = impl->context->_translator;
+
+	if (options.target_language != "")
+	{
+		auto itr = impl->context->targets.find(options.target_language);
+		if (itr == impl->context->targets.end())
+		{
+			parsed_material material;
+			material.errors = { "[0] Context does not target language: " + options.target_language };
+			return material;
+		}
+		translator = itr->second;
+	}
+
+	std::shared_ptr<const parsed_domain> domain = impl->material_domain;
+
+	if (domain_override != "")
+	{
+		auto itr = impl->context->domains.find(domain_override);
+		if (itr == impl->context->domains.end())
+		{
+			parsed_material material;
+			material.errors = { "[0] No such domain: " + domain_override };
+			return material;
+		}
+		domain = itr->second;
+	}
+
+	auto fallbacks = options.properties_fallbacks.size() == 0 ? nullptr : &options.properties_fallbacks;
+
+	//only the emitted expressions are rebound, and they are bound back to the material's domain after the emission,
+	//so expressions that were not emitted never stay bound to a domain other than the material's one
+	if (domain != impl->material_domain)
+	{
+		get_domain_expressions(state, impl->reachability, *domain, fallbacks, impl->rebound);
+
+		std::string error;
+		rebind_material_domain(state, *impl->material_domain, domain, impl->rebound, error);
+
+		if (error != "")
+		{
+			parsed_material material;
+			material.errors = { "[0] " + error };
+			return material;
+		}
+	}
+
+	auto material = translate_material(state, *impl->context, translator, fallbacks);
+
+	if (domain != impl->material_domain)
+	{
+		//rebound expressions were bound to the material's domain before, so binding them back cannot fail
+		std::string error;
+		rebind_material_domain(state, *impl->material_domain, impl->material_domain, impl->rebound, error);
+	}
+
+	return material;
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+/*
+	Static estimation of the shader cost
+	Walks validated expressions, recomputing types of the nodes to know the width of each operation
+	Costs of matl functions bodies are cached per instance, since each call evaluates the whole body
+*/
+class cost_estimator
+{
+	using stage_cost = matl::parsed_material::stage_cost;
+
+	struct function_cost
+	{
+		stage_cost cost;
+		bool estimated = false;
+	};
+
+	const context_public_implementation& context;
+	std::unordered_map<const function_instance*, function_cost> functions_costs;
+
+	//variables used by the estimated properties, and their uses count, which the estimation does not need
+	std::vector<uint64_t> dumped_variables;
+	std::vector<uint32_t> variables_uses;
+
+	//types that could not be discerned (nullptr) are counted as scalars
+	static size_t get_width_index(const data_type* type)
+	{
+		if (type == nullptr) return 0;
+
+		auto size = get_vector_size(type);
+		return size <= 1 ? 0 : size - 1;
+	}
+
+	static void add_cost(stage_cost& target, const stage_cost& cost)
+	{
+		for (size_t i = 0; i < 4; i++)
+			target.operations[i] += cost.operations[i];
+
+		target.exposed_functions_calls += cost.exposed_functions_calls;
+		target.texture_accesses += cost.texture_accesses;
+		target.conditionals += cost.conditionals;
+		target.functions_calls_depth = std::max(target.functions_calls_depth, cost.functions_calls_depth);
+		target.weighted_cost += cost.weighted_cost;
+	}
+
+	uint32_t get_operator_weight(const unary_operator_definition* operato) const
+	{
+		auto itr = context.unary_operators_costs.find(operato);
+		return itr == context.unary_operators_costs.end() ? 1 : itr->second;
+	}
+
+	uint32_t get_operator_weight(const binary_operator_definition* operato) const
+	{
+		auto itr = context.binary_operators_costs.find(operato);
+		return itr == context.binary_operators_costs.end() ? 1 : itr->second;
+	}
+
+	uint32_t get_exposed_function_weight(const named_function* function) const
+	{
+		auto itr = context.exposed_functions_costs.find(function->first);
+		return itr == context.exposed_functions_costs.end() ? 1 : itr->second;
+	}
+
+	//estimates cost of the single expression and returns it's type
+	//variables_types : types of the variables, if not found type stored in variable definition is used
+	const data_type* estimate_single_expression(
+		const expression::single_expression* single,
+		const std::unordered_map<const named_variable*, const data_type*>& variables_types,
+		stage_cost& cost
+	)
+	{
+		using node_type = expression::node::node_type;
+
+		std::vector<const data_type*> types;
+
+		auto pop_types = [&](size_t ammount)
+		{
+			types.erase(types.end() - ammount, types.end());
+		};
+
+		for (auto& node : single->nodes)
+		{
+			switch (node->get_type())
+			{
+			case node_type::scalar_literal:
+				types.push_back(scalar_data_type);
+				break;
+			case node_type::variable:
+			{
+				auto itr = variables_types.find(node->as_variable());
+				types.push_back(itr == variables_types.end() ? node->as_variable()->second.type : itr->second);
+				break;
+			}
+			case node_type::symbol:
+				types.push_back(node->as_symbol()->type);
+				break;
+			case node_type::parameter:
+				if (node->as_parameter()->second.type == texture_data_type)
+					cost.texture_accesses++;
+				types.push_back(node->as_parameter()->second.type);
+				break;
+			case node_type::unary_operator:
+			{
+				auto operato = node->as_unary_operator();
+				if (types.back() != nullptr)
+					types.back() = operato->get_returned_type(types.back());
+
+				cost.operations[get_width_index(types.back())]++;
+				cost.weighted_cost += get_operator_weight(operato);
+				break;
+			}
+			case node_type::binary_operator:
+			{
+				auto operato = node->as_binary_operator();
+				auto left = types.at(types.size() - 2);
+				auto right = types.back();
+
+				pop_types(2);
+				types.push_back(left != nullptr && right != nullptr ? operato->get_returned_type(left, right) : nullptr);
+
+				cost.operations[get_width_index(types.back())]++;
+				cost.weighted_cost += get_operator_weight(operato);
+				break;
+			}
+			case node_type::vector_contructor_operator:
+			{
+				auto components = node->as_vector_contructor_operator().first;
+				uint8_t size = 0;
+
+				for (size_t i = 0; i < components; i++)
+					size += get_vector_size(types.at(types.size() - 1 - i));
+
+				pop_types(components);
+				types.push_back(get_vector_type_of_size(size));
+				break;
+			}
+			case node_type::vector_component_access_operator:
+				types.back() = get_vector_type_of_size(static_cast<uint8_t>(node->as_vector_access_operator().size()));
+				break;
+			case node_type::function:
+			{
+				auto function = node->as_function();
+				auto& func_def = function->second;
+
+				const function_instance* instance = nullptr;
+				{
+					auto lock = lock_function_instances(func_def);
+					instance = func_def.instances.find(types.end() - func_def.arguments.size(), types.end());
+				}
+				if (instance != nullptr && !instance->valid) instance = nullptr;
+				pop_types(func_def.arguments.size());
+
+				types.push_back(instance == nullptr ? nullptr : instance->returned_type);
+
+				if (func_def.is_exposed)
+				{
+					cost.exposed_functions_calls++;
+					cost.weighted_cost += get_exposed_function_weight(function);
+				}
+				else if (instance != nullptr)
+				{
+					auto body_cost = estimate_function_instance(instance);
+					body_cost.functions_calls_depth++;
+					add_cost(cost, body_cost);
+				}
+				break;
+			}
+			default:
+				break;
+			}
+		}
+
+		return types.size() == 0 ? nullptr : types.back();
+	}
+
+	const data_type* estimate_expression(
+		const expression* exp,
+		const std::unordered_map<const named_variable*, const data_type*>& variables_types,
+		stage_cost& cost
+	)
+	{
+		const data_type* type = nullptr;
+
+		for (auto& exp_case : exp->cases)
+		{
+			if (exp_case->condition != nullptr)
+			{
+				cost.conditionals++;
+				estimate_single_expression(exp_case->condition, variables_types, cost);
+			}
+
+			type = estimate_single_expression(exp_case->value, variables_types, cost);
+		}
+
+		return type;
+	}
+
+	//cost of a single call to the function instance
+	const stage_cost& estimate_function_instance(const function_instance* instance)
+	{
+		auto& function_cost = functions_costs[instance];
+		if (function_cost.estimated) return function_cost.cost;
+
+		function_cost.estimated = true;
+
+		auto& func_def = *instance->function;
+
+		//function variables types depend on the instance, arguments are the first variables of the function
+		std::unordered_map<const named_variable*, const data_type*> variables_types;
+
+		auto var_itr = func_def.variables.begin();
+		for (auto& arg_type : instance->arguments_types)
+		{
+			variables_types.insert({ &*var_itr, arg_type });
+			var_itr++;
+		}
+
+		stage_cost cost;
+
+		for (; var_itr != func_def.variables.end(); var_itr++)
+			if (var_itr->second.value != nullptr)
+				variables_types.insert({ &*var_itr, estimate_expression(var_itr->second.value, variables_types, cost) });
+
+		if (func_def.returned_value != nullptr)
+			estimate_expression(func_def.returned_value, variables_types, cost);
+
+		functions_costs.at(instance).cost = cost;
+		return functions_costs.at(instance).cost;
+	}
+
+public:
+	cost_estimator(const context_public_implementation& _context) : context(_context) {};
+
+	//cost of evaluating given properties values, along with all variables they use
+	//each variable is evaluated only once, since it is either declared or inlined in a single place
+	//reachability : reachability of the variables of the properties' material
+	stage_cost estimate(const std::vector<expression*>& properties, variables_reachability& reachability)
+	{
+		stage_cost cost;
+
+		get_dumped_variables(reachability, properties, dumped_variables, variables_uses);
+
+		for (size_t index = 0; index < reachability.variables.size(); index++)
+			if (is_variable_reachable(dumped_variables, index))
+				estimate_expression(reachability.variables[index]->second.value, {}, cost);
+
+		for (auto& prop : properties)
+			estimate_expression(prop, {}, cost);
+
+		return cost;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,558 @@
+#pragma once
+
+/*
+	Cpu evaluation of the materials properties
+	Validated expressions are compiled into a list of instructions working on registers
+	Each register holds one component of a value for a whole chunk of the batch (structure of arrays),
+	so every instruction is a simple loop over the chunk, that compilers turn into simd code
+	Registers are never reused, constants (literals and parameters) are written only once per evaluation
+	Vectors constructors and swizzles do not generate any code; they only select registers
+*/
+
+enum class cpu_opcode : uint8_t
+{
+	add, substract, multiply, divide, negate,
+	equal, not_equal, less, greater, less_equal, greater_equal,
+	conjunct, alternate, exclusively_alternate, logical_not,
+	select,		//dst = a != 0 ? b : c
+	native		//call of native function, a is the index of the call
+};
+
+struct cpu_instruction
+{
+	cpu_opcode opcode;
+	uint32_t dst;
+	uint32_t a;
+	uint32_t b;
+	uint32_t c;
+};
+
+struct cpu_native_call
+{
+	matl::native_function* function;
+	std::vector<uint32_t> arguments;
+	std::vector<uint8_t> arguments_sizes;
+	std::vector<uint32_t> results;
+};
+
+struct matl::cpu_property::implementation
+{
+	std::vector<cpu_instruction> code;
+	std::vector<cpu_native_call> natives;
+
+	uint32_t registers_count = 0;
+
+	//literals values, stored in registers
+	std::vector<std::pair<uint32_t, float>> literals;
+
+	//registers of the parameters components, in the order of cpu_property::parameters_values
+	std::vector<uint32_t> parameters_registers;
+
+	//registers of the symbols components, in the order of cpu_property::symbols
+	std::vector<uint32_t> inputs_registers;
+
+	std::vector<uint32_t> results_registers;
+};
+
+class matl::cpu_property::compiler
+{
+	struct value
+	{
+		std::vector<uint32_t> registers;
+		const data_type* type;
+	};
+
+	using variables_values = std::unordered_map<const named_variable*, value>;
+
+	const context_public_implementation& context;
+	const material_parsing_state& state;
+
+	matl::cpu_property& property;
+	matl::cpu_property::implementation& impl;
+
+	variables_values material_variables;
+	std::unordered_map<const symbol_definition*, value> symbols;
+	std::unordered_map<const named_parameter*, value> parameters;
+
+	static uint8_t get_size(const data_type* type)
+	{
+		auto size = get_vector_size(type);
+		return size == 0 ? 1 : size;
+	}
+
+	value new_value(const data_type* type)
+	{
+		value val;
+		val.type = type;
+
+		for (uint8_t i = 0; i < get_size(type); i++)
+			val.registers.push_back(impl.registers_count++);
+
+		return val;
+	}
+
+	value get_symbol(const symbol_definition* symbol)
+	{
+		auto itr = symbols.find(symbol);
+		if (itr != symbols.end()) return itr->second;
+
+		auto val = new_value(symbol->type);
+
+		for (auto& sym : state.domain->symbols)
+			if (&sym.second == symbol)
+				property.symbols.push_back({ sym.first, get_size(symbol->type) });
+
+		for (auto& reg : val.registers)
+			impl.inputs_registers.push_back(reg);
+
+		symbols.insert({ symbol, val });
+		return val;
+	}
+
+	value get_parameter(const named_parameter* param)
+	{
+		auto itr = parameters.find(param);
+		if (itr != parameters.end()) return itr->second;
+
+		auto val = new_value(param->second.type);
+
+		property.parameters.push_back({});
+		get_parameter_info(*param, property.parameters.back());
+
+		if (param->second.type == texture_data_type)
+		{
+			//textures are passed to the native functions as the index of the texture parameter
+			impl.literals.push_back({ val.registers.front(), static_cast<float>(property.parameters.size() - 1) });
+		}
+		else
+		{
+			auto default_value = param->second.default_value_numeric.begin();
+
+			for (auto& reg : val.registers)
+			{
+				impl.parameters_registers.push_back(reg);
+				property.parameters_values.push_back(*default_value++);
+			}
+		}
+
+		parameters.insert({ param, val });
+		return val;
+	}
+
+	value compile_unary_operator(const unary_operator_definition* operato, const value& operand)
+	{
+		const data_type* type = operato->get_returned_type(operand.type);
+		if (type == nullptr) type = operand.type;
+
+		auto result = new_value(type);
+		auto opcode = operato->symbol == "not" ? cpu_opcode::logical_not : cpu_opcode::negate;
+
+		for (size_t i = 0; i < result.registers.size(); i++)
+			impl.code.push_back({ opcode, result.registers.at(i), operand.registers.at(i), 0, 0 });
+
+		return result;
+	}
+
+	value compile_binary_operator(const binary_operator_definition* operato, const value& left, const value& right)
+	{
+		static const std::unordered_map<std::string, cpu_opcode> opcodes =
+		{
+			{ "+", cpu_opcode::add },
+			{ "-", cpu_opcode::substract },
+			{ "*", cpu_opcode::multiply },
+			{ "/", cpu_opcode::divide },
+			{ "==", cpu_opcode::equal },
+			{ "!=", cpu_opcode::not_equal },
+			{ "<", cpu_opcode::less },
+			{ ">", cpu_opcode::greater },
+			{ "<=", cpu_opcode::less_equal },
+			{ ">=", cpu_opcode::greater_equal },
+			{ "and", cpu_opcode::conjunct },
+			{ "or", cpu_opcode::alternate },
+			{ "xor", cpu_opcode::exclusively_alternate }
+		};
+
+		const data_type* type = operato->get_returned_type(left.type, right.type);
+		if (type == nullptr) type = left.type;
+
+		auto result = new_value(type);
+		auto opcode = opcodes.at(operato->symbol);
+
+		//scalar operand is broadcasted to every component of the vector operand
+		for (size_t i = 0; i < result.registers.size(); i++)
+		{
+			auto a = left.registers.at(left.registers.size() == 1 ? 0 : i);
+			auto b = right.registers.at(right.registers.size() == 1 ? 0 : i);
+			impl.code.push_back({ opcode, result.registers.at(i), a, b, 0 });
+		}
+
+		return result;
+	}
+
+	value compile_function(const named_function* function, std::vector<value>& arguments, std::string& error)
+	{
+		auto& func_def = function->second;
+
+		std::vector<const data_type*> arguments_types;
+		for (auto& arg : arguments)
+			arguments_types.push_back(arg.type);
+
+		const function_instance* instance = nullptr;
+		{
+			auto lock = lock_function_instances(func_def);
+			instance = func_def.instances.find(arguments_types);
+		}
+
+		if (instance == nullptr || !instance->valid)
+		{
+			error = "Function " + function->first + " is invalid for given arguments";
+			return {};
+		}
+
+		if (func_def.is_exposed)
+		{
+			auto native = context.native_functions.find(function->first);
+			if (native == context.native_functions.end())
+			{
+				error = "No native implementation of the function: " + function->first;
+				return {};
+			}
+
+			auto result = new_value(instance->returned_type);
+
+			impl.natives.push_back({ native->second, {}, {}, result.registers });
+			auto& call = impl.natives.back();
+
+			for (auto& arg : arguments)
+			{
+				call.arguments.insert(call.arguments.end(), arg.registers.begin(), arg.registers.end());
+				call.arguments_sizes.push_back(static_cast<uint8_t>(arg.registers.size()));
+			}
+
+			impl.code.push_back({ cpu_opcode::native, 0, static_cast<uint32_t>(impl.natives.size() - 1), 0, 0 });
+			return result;
+		}
+
+		//matl functions are inlined; arguments are the first variables of the function
+		variables_values function_variables;
+
+		auto var_itr = func_def.variables.begin();
+		for (auto& arg : arguments)
+		{
+			function_variables.insert({ &*var_itr, arg });
+			var_itr++;
+		}
+
+		return compile_expression(func_def.returned_value, function_variables, error);
+	}
+
+	value compile_single_expression(const expression::single_expression* single, variables_values& variables, std::string& error)
+	{
+		using node_type = expression::node::node_type;
+
+		std::vector<value> stack;
+
+		for (auto& node : single->nodes)
+		{
+			switch (node->get_type())
+			{
+			case node_type::scalar_literal:
+			{
+				auto val = new_value(scalar_data_type);
+				impl.literals.push_back({ val.registers.front(), std::stof(node->as_scalar_literal()) });
+				stack.push_back(std::move(val));
+				break;
+			}
+			case node_type::variable:
+			{
+				auto var = node->as_variable();
+				auto itr = variables.find(var);
+
+				if (itr == variables.end())
+				{
+					auto val = compile_expression(var->second.value, variables, error);
+					if (error != "") return {};
+					itr = variables.insert({ var, std::move(val) }).first;
+				}
+
+				stack.push_back(itr->second);
+				break;
+			}
+			case node_type::symbol:
+				stack.push_back(get_symbol(node->as_symbol()));
+				break;
+			case node_type::parameter:
+				stack.push_back(get_parameter(node->as_parameter()));
+				break;
+			case node_type::unary_operator:
+				stack.back() = compile_unary_operator(node->as_unary_operator(), stack.back());
+				break;
+			case node_type::binary_operator:
+			{
+				auto right = std::move(stack.back());
+				stack.pop_back();
+				stack.back() = compile_binary_operator(node->as_binary_operator(), stack.back(), right);
+				break;
+			}
+			case node_type::vector_contructor_operator:
+			{
+				auto components = node->as_vector_contructor_operator().first;
+
+				value val;
+				for (size_t i = stack.size() - components; i < stack.size(); i++)
+					val.registers.insert(val.registers.end(), stack.at(i).registers.begin(), stack.at(i).registers.end());
+
+				val.type = get_vector_type_of_size(static_cast<uint8_t>(val.registers.size()));
+
+				stack.erase(stack.end() - components, stack.end());
+				stack.push_back(std::move(val));
+				break;
+			}
+			case node_type::vector_component_access_operator:
+			{
+				value val;
+				for (auto& component : node->as_vector_access_operator())
+					val.registers.push_back(stack.back().registers.at(component - 1));
+
+				val.type = get_vector_type_of_size(static_cast<uint8_t>(val.registers.size()));
+				stack.back() = std::move(val);
+				break;
+			}
+			case node_type::function:
+			{
+				auto function = node->as_function();
+
+				std::vector<value> arguments(
+					std::make_move_iterator(stack.end() - function->second.arguments.size()),
+					std::make_move_iterator(stack.end())
+				);
+				stack.erase(stack.end() - function->second.arguments.size(), stack.end());
+
+				stack.push_back(compile_function(function, arguments, error));
+				if (error != "") return {};
+				break;
+			}
+			default:
+				//parentheses and libraries never reach the validated output
+				error = "Cannot evaluate this expression on the cpu";
+				return {};
+			}
+		}
+
+		return stack.back();
+	}
+
+public:
+	compiler(
+		const context_public_implementation& _context,
+		const material_parsing_state& _state,
+		matl::cpu_property& _property,
+		matl::cpu_property::implementation& _impl
+	) : context(_context), state(_state), property(_property), impl(_impl) {};
+
+	value compile_expression(const expression* exp, variables_values& variables, std::string& error)
+	{
+		//all cases are evaluated, than selected from the last one to the first one
+		std::vector<std::pair<value, value>> cases;
+
+		for (auto& exp_case : exp->cases)
+		{
+			value condition;
+
+			if (exp_case->condition != nullptr)
+			{
+				condition = compile_single_expression(exp_case->condition, variables, error);
+				if (error != "") return {};
+			}
+
+			auto val = compile_single_expression(exp_case->value, variables, error);
+			if (error != "") return {};
+
+			cases.push_back({ std::move(condition), std::move(val) });
+		}
+
+		auto result = cases.back().second;
+
+		for (auto itr = cases.rbegin() + 1; itr != cases.rend(); itr++)
+		{
+			auto selected = new_value(result.type);
+
+			for (size_t i = 0; i < selected.registers.size(); i++)
+				impl.code.push_back({
+					cpu_opcode::select,
+					selected.registers.at(i),
+					itr->first.registers.front(),
+					itr->second.registers.at(i),
+					result.registers.at(i)
+				});
+
+			result = std::move(selected);
+		}
+
+		return result;
+	}
+
+	void compile_property(const expression* exp, std::string& error)
+	{
+		auto result = compile_expression(exp, material_variables, error);
+		rethrow_error();
+
+		impl.results_registers = result.registers;
+		property.size = static_cast<uint8_t>(result.registers.size());
+	}
+};
+
+bool matl::cpu_property::set_parameter(const std::string& name, const std::list<float>& value)
+{
+	size_t first_component = 0;
+
+	for (auto& param : parameters)
+	{
+		if (param.type == parsed_material::parameter::type::texture) continue;
+
+		if (param.name == name)
+		{
+			if (param.numeric_default_value.size() != value.size()) return false;
+
+			for (auto& component : value)
+				parameters_values.at(first_component++) = component;
+
+			return true;
+		}
+
+		first_component += param.numeric_default_value.size();
+	}
+
+	return false;
+}
+
+void matl::cpu_property::evaluate(const float* const* inputs, float* const* results, size_t count) const
+{
+	if (impl == nullptr) return;
+
+	//amount of values evaluated at once by each instruction
+	constexpr size_t chunk_size = 64;
+
+	std::vector<float> registers(impl->registers_count * chunk_size);
+	float* regs = registers.data();
+
+	auto broadcast = [&](uint32_t reg, float value)
+	{
+		std::fill(regs + reg * chunk_size, regs + (reg + 1) * chunk_size, value);
+	};
+
+	for (auto& literal : impl->literals)
+		broadcast(literal.first, literal.second);
+
+	for (size_t i = 0; i < impl->parameters_registers.size(); i++)
+		broadcast(impl->parameters_registers.at(i), parameters_values.at(i));
+
+	std::vector<const float*> native_arguments;
+	std::vector<float*> native_results;
+
+	for (size_t begin = 0; begin < count; begin += chunk_size)
+	{
+		const size_t n = std::min(chunk_size, count - begin);
+
+		for (size_t i = 0; i < impl->inputs_registers.size(); i++)
+			std::copy(inputs[i] + begin, inputs[i] + begin + n, regs + impl->inputs_registers.at(i) * chunk_size);
+
+		for (auto& instruction : impl->code)
+		{
+			float* dst = regs + instruction.dst * chunk_size;
+			const float* a = regs + instruction.a * chunk_size;
+			const float* b = regs + instruction.b * chunk_size;
+			const float* c = regs + instruction.c * chunk_size;
+
+			switch (instruction.opcode)
+			{
+			case cpu_opcode::add:					for (size_t i = 0; i < n; i++) dst[i] = a[i] + b[i]; break;
+			case cpu_opcode::substract:				for (size_t i = 0; i < n; i++) dst[i] = a[i] - b[i]; break;
+			case cpu_opcode::multiply:				for (size_t i = 0; i < n; i++) dst[i] = a[i] * b[i]; break;
+			case cpu_opcode::divide:				for (size_t i = 0; i < n; i++) dst[i] = a[i] / b[i]; break;
+			case cpu_opcode::negate:				for (size_t i = 0; i < n; i++) dst[i] = -a[i]; break;
+			case cpu_opcode::equal:					for (size_t i = 0; i < n; i++) dst[i] = a[i] == b[i] ? 1.f : 0.f; break;
+			case cpu_opcode::not_equal:				for (size_t i = 0; i < n; i++) dst[i] = a[i] != b[i] ? 1.f : 0.f; break;
+			case cpu_opcode::less:					for (size_t i = 0; i < n; i++) dst[i] = a[i] < b[i] ? 1.f : 0.f; break;
+			case cpu_opcode::greater:				for (size_t i = 0; i < n; i++) dst[i] = a[i] > b[i] ? 1.f : 0.f; break;
+			case cpu_opcode::less_equal:			for (size_t i = 0; i < n; i++) dst[i] = a[i] <= b[i] ? 1.f : 0.f; break;
+			case cpu_opcode::greater_equal:			for (size_t i = 0; i < n; i++) dst[i] = a[i] >= b[i] ? 1.f : 0.f; break;
+			case cpu_opcode::conjunct:				for (size_t i = 0; i < n; i++) dst[i] = (a[i] != 0.f) & (b[i] != 0.f) ? 1.f : 0.f; break;
+			case cpu_opcode::alternate:				for (size_t i = 0; i < n; i++) dst[i] = (a[i] != 0.f) | (b[i] != 0.f) ? 1.f : 0.f; break;
+			case cpu_opcode::exclusively_alternate:	for (size_t i = 0; i < n; i++) dst[i] = (a[i] != 0.f) != (b[i] != 0.f) ? 1.f : 0.f; break;
+			case cpu_opcode::logical_not:			for (size_t i = 0; i < n; i++) dst[i] = a[i] == 0.f ? 1.f : 0.f; break;
+			case cpu_opcode::select:				for (size_t i = 0; i < n; i++) dst[i] = a[i] != 0.f ? b[i] : c[i]; break;
+			case cpu_opcode::native:
+			{
+				auto& call = impl->natives.at(instruction.a);
+
+				native_arguments.clear();
+				for (auto& reg : call.arguments)
+					native_arguments.push_back(regs + reg * chunk_size);
+
+				native_results.clear();
+				for (auto& reg : call.results)
+					native_results.push_back(regs + reg * chunk_size);
+
+				call.function({
+					native_arguments.data(),
+					call.arguments_sizes.data(),
+					call.arguments_sizes.size(),
+					native_results.data(),
+					static_cast<uint8_t>(native_results.size()),
+					n
+				});
+				break;
+			}
+			}
+		}
+
+		for (size_t i = 0; i < impl->results_registers.size(); i++)
+		{
+			const float* result = regs + impl->results_registers.at(i) * chunk_size;
+			std::copy(result, result + n, results[i] + begin);
+		}
+	}
+}
+
+matl::cpu_property matl::compile_property(const std::string& material_source, const std::string& property_name, matl::context* context)
+{
+	cpu_property property;
+
+	material_parsing_state state;
+	parsed_material failure;
+
+	if (!parse_material_state(material_source, context == nullptr ? nullptr : &context->impl->impl, state, failure))
+	{
+		property.errors = std::move(failure.errors);
+		return property;
+	}
+
+	auto& context_impl = context->impl->impl;
+
+	auto prop = state.properties.find(property_name);
+	if (prop == state.properties.end())
+	{
+		property.errors = { "[0] No such property: " + property_name };
+		return property;
+	}
+
+	auto impl = std::make_shared<cpu_property::implementation>();
+
+	std::string error;
+	cpu_property::compiler compiler(context_impl, state, property, *impl);
+	compiler.compile_property(prop->second.value, error);
+
+	if (error != "")
+	{
+		property.symbols.clear();
+		property.parameters.clear();
+		property.parameters_values.clear();
+		property.errors = { "[0] " + error };
+		return property;
+	}
+
+	property.impl = std::move(impl);
+	property.success = true;
+	return property;
+}
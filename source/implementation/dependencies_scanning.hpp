@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+	Cheap scan of the material's using lines, without parsing anything else
+	Only lines starting with the using keyword (with no indentation) are read, the rest is skipped to the nearest line end
+*/
+matl::material_dependencies matl::scan_dependencies(const std::string& material_source)
+{
+	return scan_dependencies(source_view(material_source));
+}
+
+matl::material_dependencies matl::scan_dependencies(const source_view& material_source)
+{
+	material_dependencies dependencies;
+
+	auto& source = material_source;
+	const char* chars = source.data();
+	const std::string using_keyword = "using";
+
+	auto is_blank = [](const char& c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	};
+
+	size_t iterator = 0;
+	int line_counter = 0;
+
+	while (iterator < source.size())
+	{
+		line_counter++;
+
+		size_t line_end = std::find(chars + iterator, chars + source.size(), '\n') - chars;
+
+		if (
+			line_end - iterator > using_keyword.size() &&
+			std::equal(using_keyword.begin(), using_keyword.end(), chars + iterator) &&
+			is_blank(source.at(iterator + using_keyword.size()))
+		)
+		{
+			size_t comment = std::find(chars + iterator, chars + line_end, comment_char) - chars;
+
+			size_t begin = iterator + using_keyword.size();
+			while (begin < comment && is_blank(source.at(begin))) begin++;
+
+			size_t end = begin;
+			while (end < comment && !is_blank(source.at(end))) end++;
+
+			std::string using_type = source.substr(begin, end - begin);
+
+			begin = end;
+			while (begin < comment && is_blank(source.at(begin))) begin++;
+
+			end = comment;
+			while (end > begin && is_blank(source.at(end - 1))) end--;
+
+			std::string argument = source.substr(begin, end - begin);
+
+			if (using_type == "domain")
+				dependencies.domain = { std::move(argument), line_counter };
+			else if (using_type == "library")
+				dependencies.libraries.push_back({ std::move(argument), line_counter });
+			else if (using_type != "parameter" && using_type != "")
+				dependencies.custom_usings.push_back({ std::move(using_type), std::move(argument), line_counter });
+		}
+
+		iterator = line_end + 1;
+	}
+
+	return dependencies;
+}
@@ -12,28 +12,53 @@ enum class directive_type
 	split
 };
 
+/*
+	- payload : names the directive refers to (properties, insertion, symbol)
+	- text : text of the dump block, part of the domain's source
+*/
 struct directive
 {
 	directive_type type;
 	std::vector<std::string> payload;
+	string_view text{ nullptr };
+
 	directive(directive_type _type, std::vector<std::string> _payload)
 		: type(std::move(_type)), payload(std::move(_payload)) {};
+
+	static inline directive new_dump_block(string_view text)
+	{
+		directive block{ directive_type::dump_block, {} };
+		block.text = text;
+		return block;
+	}
 };
 
+//definitions are parts of the domain's source
 struct symbol_definition
 {
 	const data_type* type;
-	std::vector<std::string> definitions;
+	std::vector<string_view> definitions;
 
-	symbol_definition(const data_type* _type, std::string _definition)
+	symbol_definition(const data_type* _type, string_view _definition)
 		: type(_type), definitions({ _definition }) {};
 };
 
 struct parsed_domain
 {
+	//source of the domain, kept so dump blocks and symbols definitions can refer to it instead of copying their text
+	std::shared_ptr<const std::string> source;
+
 	std::vector<directive> directives;
 
 	heterogeneous_map<std::string, const data_type*, hgm_string_solver>  properties;
+
+	//cheap values of the properties, that can replace the material's values in material variants (eg. for distant objects)
+	heterogeneous_map<std::string, property_value, hgm_string_solver> properties_fallbacks;
 	heterogeneous_map<std::string, symbol_definition, hgm_string_solver> symbols;
 	function_collection functions;
+
+	parameters_layout_type parameters_layout = parameters_layout_type::separate;
+
+	//symbol used to index parameters buffer, only used with parameters_layout_type::buffer
+	const symbol_definition* parameters_index_symbol = nullptr;
 };
@@ -10,21 +10,22 @@ struct domain_parsing_state
 	bool expose_scope = false;
 	bool redef_scope = false;
 	bool dump_properties_depedencies_scope = false;
+	bool parameters_dumped = false;
 };
 
 using directive_handle =
-void(*)(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);;
+void(*)(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);;
 
 namespace domain_directives_handles
 {
-	void expose(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
-	void redef(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
-	void end(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
-	void property(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
-	void symbol(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
-	void function(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
-	void dump(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
-	void split(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
+	void expose(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
+	void redef(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
+	void end(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
+	void property(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
+	void symbol(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
+	void function(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
+	void dump(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
+	void split(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error);
 }
 
 heterogeneous_map<std::string, directive_handle, hgm_string_solver> directives_handles_map =
@@ -42,13 +43,21 @@ heterogeneous_map<std::string, directive_handle, hgm_string_solver> directives_h
 };
 
 matl::domain_parsing_raport matl::parse_domain(const std::string domain_name, const std::string& domain_source, matl::context* context)
+{
+	return parse_domain(domain_name, source_view(domain_source), context);
+}
+
+matl::domain_parsing_raport matl::parse_domain(const std::string domain_name, const source_view& domain_source, matl::context* context)
 {
 	auto& context_impl = context->impl->impl;
 
 	domain_parsing_state state;
 	state.domain = std::make_shared<parsed_domain>();
 
-	auto& source = domain_source;
+	//the only copy of the source, everything is parsed from it, so the parsed domain can refer to it's parts
+	state.domain->source = std::make_shared<const std::string>(domain_source.data(), domain_source.size());
+
+	const source_view source = *state.domain->source;
 	auto& iterator = state.iterator;
 
 	size_t last_position = 0;
@@ -59,15 +68,12 @@ matl::domain_parsing_raport matl::parse_domain(const std::string domain_name, co
 		std::string error;
 		bool whitespaces_only = true;
 
-		get_to_char_while_counting_lines('<', domain_source, iterator, line_counter, whitespaces_only);
+		get_to_char_while_counting_lines('<', source, iterator, line_counter, whitespaces_only);
 
 		if (last_position != iterator && !whitespaces_only)
 		{
 			state.domain->directives.push_back(
-				{
-					directive_type::dump_block,
-					{ std::move(domain_source.substr(last_position, iterator - last_position)) }
-				}
+				directive::new_dump_block({ source, last_position, iterator })
 			);
 		}
 
@@ -84,7 +90,7 @@ matl::domain_parsing_raport matl::parse_domain(const std::string domain_name, co
 			if (handle == directives_handles_map.end())
 			{
 				error = "No such directive: " + std::string(directive);
-				get_to_char_while_counting_lines('>', domain_source, iterator, line_counter, whitespaces_only);
+				get_to_char_while_counting_lines('>', source, iterator, line_counter, whitespaces_only);
 				goto _parse_domain_handle_error;
 			}
 			else
@@ -100,7 +106,7 @@ matl::domain_parsing_raport matl::parse_domain(const std::string domain_name, co
 				}
 			}
 
-			get_to_char_while_counting_lines('>', domain_source, iterator, line_counter, whitespaces_only);
+			get_to_char_while_counting_lines('>', source, iterator, line_counter, whitespaces_only);
 			iterator++;
 
 			last_position = iterator;
@@ -127,19 +133,19 @@ matl::domain_parsing_raport matl::parse_domain(const std::string domain_name, co
 }
 
 
-void domain_directives_handles::expose(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
+void domain_directives_handles::expose(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
 {
 	throw_error(state.expose_scope || state.dump_properties_depedencies_scope || state.redef_scope, "Cannot use this directive here");
 	state.expose_scope = true;
 }
 
-void domain_directives_handles::redef(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
+void domain_directives_handles::redef(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
 {
 	throw_error(state.expose_scope || state.dump_properties_depedencies_scope || state.redef_scope, "Cannot use this directive here");
 	state.redef_scope = true;
 }
 
-void domain_directives_handles::end(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
+void domain_directives_handles::end(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
 {
 	throw_error(!state.expose_scope && !state.dump_properties_depedencies_scope && !state.redef_scope, "Cannot use this directive here");
 	state.expose_scope = false;
@@ -147,7 +153,7 @@ void domain_directives_handles::end(const std::string& source, context_public_im
 	state.dump_properties_depedencies_scope = false;
 }
 
-void domain_directives_handles::property(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
+void domain_directives_handles::property(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
 {
 	throw_error(state.redef_scope, "Cannot use this directive here");
 
@@ -168,6 +174,43 @@ void domain_directives_handles::property(const std::string& source, context_publ
 		if (type == nullptr) error = "No such type: " + std::string(type_name);
 
 		state.domain->properties.insert({ name, type });
+		rethrow_error();
+
+		get_spaces(source, state.iterator);
+		if (source.at(state.iterator) != '=') return;
+		state.iterator++;
+
+		//fallback is a matl expression, that can only use literals and domain's symbols and functions
+		size_t begin = state.iterator;
+		get_to_char('>', source, state.iterator);
+
+		std::string fallback_source = source.substr(begin, state.iterator - begin);
+
+		tokenized_source fallback_tokens;
+		tokenize_source(fallback_source, fallback_tokens);
+
+		//the expression starts after the line_begin token, an empty fallback has only the source_end token
+		size_t fallback_iterator = is_at_source_end(fallback_tokens, 0) ? 0 : 1;
+		int fallback_lines = 0;
+
+		const data_type* fallback_type = nullptr;
+
+		auto& fallback = state.domain->properties_fallbacks.insert({ name, {} })->second;
+		fallback.value = get_expression(
+			fallback_tokens,
+			fallback_iterator,
+			0,
+			fallback_lines,
+			&context.common_names,
+			context,
+			state.domain,
+			&fallback_type,
+			error
+		);
+		rethrow_error();
+
+		throw_error(fallback_type != type, 
+			"Invalid property fallback type; expected: " + type->name + " got: " + fallback_type->name);
 	}
 	else if (state.dump_properties_depedencies_scope)
 	{
@@ -195,7 +238,7 @@ void domain_directives_handles::property(const std::string& source, context_publ
 	}
 }
 
-void domain_directives_handles::symbol(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
+void domain_directives_handles::symbol(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
 {
 	throw_error(state.dump_properties_depedencies_scope, "Cannot use this directive here");
 	throw_error(!state.expose_scope && !state.redef_scope, "Cannot use this directive here");
@@ -225,7 +268,7 @@ void domain_directives_handles::symbol(const std::string& source, context_public
 		throw_error(state.domain->symbols.find(name) != state.domain->symbols.end(),
 			"Cannot use this name; Symbol named: " + std::string(name) + " already exists");
 
-		state.domain->symbols.insert({ name, {type, source.substr(begin, state.iterator - begin)} });
+		state.domain->symbols.insert({ name, {type, string_view(source, begin, state.iterator)} });
 	}
 	else if (state.redef_scope)
 	{
@@ -236,14 +279,14 @@ void domain_directives_handles::symbol(const std::string& source, context_public
 
 		throw_error(type != symbol->second.type, "Cannot change symbol type");
 
-		symbol->second.definitions.push_back(source.substr(begin, state.iterator - begin));
+		symbol->second.definitions.push_back(string_view(source, begin, state.iterator));
 
 		state.domain->directives.push_back(
 			{ directive_type::change_symbol_definition, { std::move(name) } });
 	}
 }
 
-void domain_directives_handles::function(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
+void domain_directives_handles::function(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
 {
 	auto& iterator = state.iterator;
 
@@ -310,18 +353,16 @@ void domain_directives_handles::function(const std::string& source, context_publ
 
 	throw_error(func_def.arguments.size() != arguments_types.size(), "Cannot expose a function instance with a different amount of arguments than in other instances")
 
-	func_def.instances.push_back({ &func_def });
-	auto& func_instance = func_def.instances.back();
+	auto& func_instance = func_def.instances.add(&func_def, std::move(arguments_types));
 
 	func_instance.function_native_name = function_native_name;
 	func_instance.returned_type = returned_type;
-	func_instance.arguments_types = std::move(arguments_types);
 	func_instance.valid = true;
 
 	get_to_char('>', source, state.iterator);
 }
 
-void domain_directives_handles::dump(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
+void domain_directives_handles::dump(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
 {
 	throw_error(state.expose_scope, "Cannot use this directive here");
 	throw_error(state.redef_scope, "Cannot use this directive here");
@@ -343,6 +384,48 @@ void domain_directives_handles::dump(const std::string& source, context_public_i
 	}
 	else if (dump_type == "parameters")
 	{
+		auto layout = parameters_layout_type::separate;
+
+		get_spaces(source, state.iterator);
+		if (source.at(state.iterator) != '>')
+		{
+			auto layout_name = get_string_ref(source, state.iterator, error);
+			rethrow_error();
+
+			if (layout_name == "block")
+				layout = parameters_layout_type::block;
+			else if (layout_name == "buffer")
+				layout = parameters_layout_type::buffer;
+			else
+				throw_error(true, "Invalid parameters layout: " + std::string(layout_name));
+		}
+
+		const symbol_definition* index_symbol = nullptr;
+
+		if (layout == parameters_layout_type::buffer)
+		{
+			get_spaces(source, state.iterator);
+			auto symbol_name = get_string_ref(source, state.iterator, error);
+			rethrow_error();
+
+			auto symbol = state.domain->symbols.find(symbol_name);
+			throw_error(symbol == state.domain->symbols.end(), "No such symbol: " + std::string(symbol_name));
+			throw_error(symbol->second.type != scalar_data_type, "Parameters buffer index must be a scalar symbol");
+
+			index_symbol = &symbol->second;
+		}
+
+		throw_error(state.parameters_dumped && state.domain->parameters_layout != layout,
+			"All parameters dumps must use the same layout");
+
+		throw_error(state.parameters_dumped && state.domain->parameters_index_symbol != index_symbol,
+			"All parameters dumps must use the same index symbol");
+
+		state.domain->parameters_index_symbol = index_symbol;
+
+		state.domain->parameters_layout = layout;
+		state.parameters_dumped = true;
+
 		state.domain->directives.push_back({ directive_type::dump_parameters, {} });
 	}
 	else if (dump_type == "insertion")
@@ -359,7 +442,7 @@ void domain_directives_handles::dump(const std::string& source, context_public_i
 	get_to_char('>', source, state.iterator);
 }
 
-void domain_directives_handles::split(const std::string& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
+void domain_directives_handles::split(const source_view& source, context_public_implementation& context, domain_parsing_state& state, std::string& error)
 {
 	throw_error(state.expose_scope, "Cannot use this directive here");
 	throw_error(state.redef_scope, "Cannot use this directive here");
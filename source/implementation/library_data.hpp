@@ -3,5 +3,26 @@
 struct parsed_library
 {
 	heterogeneous_map<std::string, function_definition, hgm_string_solver> functions;
+
+	//libraries used by the library
+	heterogeneous_map<std::string, std::shared_ptr<parsed_library>, hgm_string_solver> libraries;
+
+	//copy of the library source and its tokens, kept only if functions bodies are parsed lazily
+	std::shared_ptr<const std::string> source;
+	tokenized_source tokenized;
+
+	//names declared in the library, lazily parsed functions bodies are resolved in it
+	names_scope names;
+
+	//guards the functions instances and the translations cached in them, since the library is shared by all the materials using it
+	//recursive since instantiating a function instantiates functions it calls
+	std::recursive_mutex instances_mutex;
 };
-using libraries_collection = heterogeneous_map<std::string, std::shared_ptr<parsed_library>, hgm_string_solver>;
\ No newline at end of file
+using libraries_collection = heterogeneous_map<std::string, std::shared_ptr<parsed_library>, hgm_string_solver>;
+
+//locks the instances of the library function; functions declared in materials belong to a single material and are not locked
+inline std::unique_lock<std::recursive_mutex> lock_function_instances(const function_definition& func_def)
+{
+	if (func_def.library == nullptr) return {};
+	return std::unique_lock<std::recursive_mutex>(func_def.library->second->instances_mutex);
+}
\ No newline at end of file
@@ -41,6 +41,7 @@ void parsed_libraries_stack::pop()
 
 struct library_parsing_state
 {
+	//index of the current token
 	size_t iterator = 0;
 	int line_counter = 0;
 	int this_line_indentation_spaces = 0;
@@ -53,12 +54,16 @@ struct library_parsing_state
 	function_collection functions;
 	libraries_collection libraries;
 
+	//names declared in the library, and in the currently parsed function
+	names_scope names;
+	names_scope function_names;
+
 	string_view library_name{ "" };
 };
 
 
 using library_keyword_handle = void(*)(
-	const std::string& material_source,
+	const tokenized_source& material_source,
 	context_public_implementation& context,
 	library_parsing_state& state,
 	std::string& error
@@ -66,11 +71,11 @@ using library_keyword_handle = void(*)(
 
 namespace library_keywords_handles
 {
-	void let(const std::string&, context_public_implementation&, library_parsing_state&, std::string&);
-	void property(const std::string&, context_public_implementation&, library_parsing_state&, std::string&);
-	void _using(const std::string&, context_public_implementation&, library_parsing_state&, std::string&);
-	void func(const std::string&, context_public_implementation&, library_parsing_state&, std::string&);
-	void _return(const std::string&, context_public_implementation&, library_parsing_state&, std::string&);
+	void let(const tokenized_source&, context_public_implementation&, library_parsing_state&, std::string&);
+	void property(const tokenized_source&, context_public_implementation&, library_parsing_state&, std::string&);
+	void _using(const tokenized_source&, context_public_implementation&, library_parsing_state&, std::string&);
+	void func(const tokenized_source&, context_public_implementation&, library_parsing_state&, std::string&);
+	void _return(const tokenized_source&, context_public_implementation&, library_parsing_state&, std::string&);
 }
 
 heterogeneous_map<std::string, library_keyword_handle, hgm_string_solver> library_keywords_handles_map =
@@ -86,7 +91,7 @@ heterogeneous_map<std::string, library_keyword_handle, hgm_string_solver> librar
 
 void parse_library_implementation(
 	const std::string library_name,
-	const std::string& library_source,
+	const source_view& library_source,
 	context_public_implementation* context,
 	std::shared_ptr<parsed_libraries_stack> stack,
 	std::list<matl::library_parsing_raport>* parsing_raports
@@ -110,21 +115,33 @@ void parse_library_implementation(
 	state.parsed_libs_stack = stack;
 	state.library_name = library_name;
 	state.parsing_raports = parsing_raports;
+	state.names.set_parent(&context->common_names);
 
-	while (!is_at_source_end(library_source, state.iterator))
-	{
-		state.line_counter++;
+	tokenized_source source;
+	tokenize_source(library_source, source);
+
+	auto& iterator = state.iterator;
 
+	while (!is_at_source_end(source, iterator))
+	{
 		std::string error;
 
-		auto& source = library_source;
-		auto& iterator = state.iterator;
+		auto& line = source.at(iterator++);
+		state.line_counter = line.line;
 
-		int spaces = get_spaces(source, iterator);
-		if (is_at_source_end(library_source, state.iterator)) break;
+		int spaces = line.indentation;
 
-		if (source.at(iterator) == comment_char) goto _parse_library_next_line;
-		if (is_at_line_end(source, iterator)) goto _parse_library_next_line;
+		//lazily parsed function body ends with the first line that is not indented
+		if (state.function_body && context->lazy_libraries)
+		{
+			if (spaces != 0)
+			{
+				get_to_new_line(source, iterator);
+				continue;
+			}
+
+			state.function_body = false;
+		}
 
 		if (state.function_body)
 		{
@@ -169,21 +186,16 @@ void parse_library_implementation(
 				goto _parse_library_handle_error;
 			}
 
-			kh_itr->second(library_source, *context, state, error);
+			kh_itr->second(source, *context, state, error);
 			if (error != "") goto _parse_library_handle_error;
 		}
 
-	_parse_library_next_line:
-		if (is_at_source_end(library_source, state.iterator)) break;
-		get_to_new_line(library_source, state.iterator);
-
+		get_to_new_line(source, iterator);
 		continue;
 
 	_parse_library_handle_error:
 		state.errors.push_back('[' + std::to_string(state.line_counter) + "] " + std::move(error));
-
-		if (is_at_source_end(library_source, state.iterator)) break;
-		get_to_new_line(library_source, state.iterator);
+		get_to_new_line(source, iterator);
 	}
 
 	matl::library_parsing_raport raport;
@@ -194,6 +206,18 @@ void parse_library_implementation(
 		raport.success = true;
 		auto parsed = std::make_shared<parsed_library>();
 		parsed->functions = std::move(state.functions);
+		parsed->libraries = std::move(state.libraries);
+
+		//the records are moved along with the lists that own them, so the scope still refers to them
+		parsed->names = std::move(state.names);
+
+		//tokens are kept along with the copy of the source, their spans are positions, so they apply to the copy as well
+		if (context->lazy_libraries)
+		{
+			parsed->source = std::make_shared<const std::string>(library_source.data(), library_source.size());
+			parsed->tokenized.source = *parsed->source;
+			parsed->tokenized.tokens = std::move(source.tokens);
+		}
 
 		context->libraries.insert({ library_name, parsed });
 
@@ -210,7 +234,143 @@ void parse_library_implementation(
 	parsing_raports->push_back(raport);
 }
 
+//finds the library in the context; if it is not loaded yet it's source is requested with the context's callback and the library is parsed
+//stack, raports : state of the libraries parsing, when called while parsing another library
+void get_library(
+	const string_view& library_name,
+	context_public_implementation& context,
+	std::shared_ptr<parsed_libraries_stack> stack,
+	std::list<matl::library_parsing_raport>& raports,
+	std::shared_ptr<parsed_library>& library,
+	std::string& error
+)
+{
+	std::lock_guard<std::recursive_mutex> lock(context.libraries_mutex);
+
+	auto itr = context.libraries.find(library_name);
+
+	if (itr == context.libraries.end())
+	{
+		throw_error(context.lsr == nullptr && context.lsvr == nullptr, "No such library: " + std::string(library_name));
+
+		source_view library_source;
+
+		if (context.lsvr != nullptr)
+		{
+			library_source = context.lsvr(library_name, error);
+			rethrow_error();
+			throw_error(library_source.data() == nullptr, "No such library: " + std::string(library_name));
+		}
+		else
+		{
+			const std::string* requested_source = context.lsr(library_name, error);
+			rethrow_error();
+			throw_error(requested_source == nullptr, "No such library: " + std::string(library_name));
+			library_source = *requested_source;
+		}
+
+		parse_library_implementation(library_name, library_source, &context, stack, &raports);
+
+		auto& raport = raports.back();
+		throw_error(!raport.success, "Failed to parse library: " + raport.library_name + "; " + raport.errors.front());
+
+		itr = context.libraries.find(library_name);
+	}
+
+	library = itr->second;
+}
+
+//parses the body of the library function, which was skipped when the library was parsed lazily
+//must be called with the context's libraries mutex locked
+void parse_lazy_function_body(function_definition& func_def, context_public_implementation& context, std::string& error)
+{
+	func_def.lazy_body = false;
+
+	auto& library = *func_def.library->second;
+	auto& source = library.tokenized;
+
+	size_t iterator = func_def.lazy_body_begin;
+	int line_counter = 0;
+	int indentation = 0;
+
+	names_scope function_names{ &library.names, true };
+	for (auto& arg : func_def.variables)
+		function_names.declare(arg.first, scope_entity::new_variable(&arg));
+
+	while (!is_at_source_end(source, iterator) && func_def.returned_value == nullptr)
+	{
+		auto& line = source.at(iterator++);
+		line_counter = line.line;
+
+		int spaces = line.indentation;
+
+		if (spaces == 0) break;
+
+		if (indentation == 0) indentation = spaces;
+
+		{
+			if (spaces != indentation)
+			{
+				error = "Indentation level must be consistient";
+				goto _parse_lazy_function_body_handle_error;
+			}
+
+			auto keyword = get_string_ref(source, iterator, error);
+			if (error != "") goto _parse_lazy_function_body_handle_error;
+
+			if (keyword == "let")
+			{
+				auto var_name = get_string_ref(source, iterator, error);
+				if (error != "") goto _parse_lazy_function_body_handle_error;
+
+				if (!get_operator(source, iterator, "="))
+				{
+					error = "Expected '='";
+					goto _parse_lazy_function_body_handle_error;
+				}
+
+				is_name_unique(var_name, function_names, error);
+				if (error != "") goto _parse_lazy_function_body_handle_error;
+
+				auto& var = *func_def.variables.insert({ var_name, {} });
+				function_names.declare(var_name, scope_entity::new_variable(&var));
+
+				auto& var_def = var.second;
+				var_def.definition_line = line_counter;
+
+				var_def.value = get_expression(
+					source, iterator, indentation, line_counter,
+					&function_names, context, nullptr, nullptr, error
+				);
+			}
+			else if (keyword == "return")
+			{
+				func_def.returned_value = get_expression(
+					source, iterator, indentation, line_counter,
+					&function_names, context, nullptr, nullptr, error
+				);
+			}
+			else error = "Cannot use " + std::string(keyword) + " inside function body";
+
+			if (error != "") goto _parse_lazy_function_body_handle_error;
+		}
+
+		get_to_new_line(source, iterator);
+		continue;
+
+	_parse_lazy_function_body_handle_error:
+		func_def.valid = false;
+		error = '[' + std::to_string(line_counter) + "] " + error;
+		return;
+	}
+}
+
 std::list<matl::library_parsing_raport> matl::parse_library(const std::string library_name, const std::string& library_source, matl::context* context)
+{
+	return parse_library(library_name, source_view(library_source), context);
+}
+
+std::list<matl::library_parsing_raport> matl::parse_library(const std::string library_name, const source_view& library_source, matl::context* context)
 {
 	if (context == nullptr)
 	{
@@ -221,6 +381,8 @@ std::list<matl::library_parsing_raport> matl::parse_library(const std::string li
 		return { raport };
 	}
 
+	std::lock_guard<std::recursive_mutex> lock(context->impl->impl.libraries_mutex);
+
 	std::list<matl::library_parsing_raport> raports;
 	parse_library_implementation(
 		library_name,
@@ -234,40 +396,30 @@ std::list<matl::library_parsing_raport> matl::parse_library(const std::string li
 }
 
 void library_keywords_handles::let
-(const std::string& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
 {
 	if (!state.function_body)
 		throw_error(true, "Cannot declare variables in library");
 
 	auto& iterator = state.iterator;
 
-	get_spaces(source, iterator);
 	auto var_name = get_string_ref(source, iterator, error);
 	rethrow_error();
 
-	get_spaces(source, iterator);
-	auto assign_operator = get_char(source, iterator);
-
-	if (assign_operator != '=')
+	if (!get_operator(source, iterator, "="))
 		error = "Expected '='";
 
 	rethrow_error();
 
 	auto& func_def = state.functions.recent().second;
 
-	is_name_unique(
-		var_name, 
-		&func_def.variables, 
-		nullptr,
-		nullptr, 
-		&state.functions,
-		context,
-		&state.libraries, 
-		error
-	);
+	is_name_unique(var_name, state.function_names, error);
 	rethrow_error();
 
-	auto& var_def = func_def.variables.insert({ var_name, {} })->second;
+	auto& var = *func_def.variables.insert({ var_name, {} });
+	state.function_names.declare(var_name, scope_entity::new_variable(&var));
+
+	auto& var_def = var.second;
 	var_def.definition_line = state.line_counter;
 
 	var_def.value = get_expression(
@@ -275,12 +427,10 @@ void library_keywords_handles::let
 		iterator,
 		state.this_line_indentation_spaces,
 		state.line_counter,
-		&func_def.variables,
-		nullptr,
-		&state.functions,
-		&state.libraries,
+		&state.function_names,
 		context,
 		nullptr,
+		nullptr,
 		error
 	);
 	if (error != "") func_def.valid = false;
@@ -288,19 +438,18 @@ void library_keywords_handles::let
 }
 
 void library_keywords_handles::property
-(const std::string& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
 {
 	throw_error(true, "Cannot use property inside library");
 }
 
 void library_keywords_handles::_using
-(const std::string& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
 {
 	throw_error(state.function_body, "Cannot use using in this scope");
 
 	auto& iterator = state.iterator;
 
-	get_spaces(source, iterator);
 	auto using_type = get_string_ref(source, iterator, error);
 	rethrow_error();
 
@@ -310,30 +459,14 @@ void library_keywords_handles::_using
 	}
 	else if (using_type == "library")
 	{
-		get_spaces(source, iterator);
 		auto library_name = get_rest_of_line(source, iterator);
 
-		auto itr = context.libraries.find(library_name);
-		throw_error(itr == context.libraries.end(), "No such library: " + std::string(library_name));
-
-		if (itr == context.libraries.end() && context.lsr != nullptr)
-		{
-			error = "";
-
-			const std::string* nested_lib_source = context.lsr(library_name, error);
-			rethrow_error();
-			throw_error(nested_lib_source == nullptr, "No such library: " + std::string(library_name));
-
-			parse_library_implementation(library_name, *nested_lib_source, &context, state.parsed_libs_stack, state.parsing_raports);
-
-			throw_error(!state.parsing_raports->back().success, error);
-
-			itr = context.libraries.find(library_name);
-		}
-
+		std::shared_ptr<parsed_library> library;
+		get_library(library_name, context, state.parsed_libs_stack, *state.parsing_raports, library, error);
 		rethrow_error();
 
-		state.libraries.insert({ library_name, itr->second });
+		auto& named_lib = *state.libraries.insert({ library_name, library });
+		state.names.declare(library_name, scope_entity::new_library(&named_lib));
 	}
 	else if (using_type == "parameter")
 	{
@@ -344,38 +477,34 @@ void library_keywords_handles::_using
 		auto itr = context.custom_using_handles.find(using_type);
 		throw_error(itr == context.custom_using_handles.end(), "No such using case: " + std::string(using_type));
 
-		get_spaces(source, iterator);
 		auto arg = get_rest_of_line(source, iterator);;
 		itr->second(arg, error);
 	}
 }
 
 void library_keywords_handles::func
-(const std::string& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
 {
-	get_spaces(source, state.iterator);
 	std::string func_name = get_string_ref(source, state.iterator, error);
 	throw_error(func_name == "", "Expected function name");
 	rethrow_error();
 
-	is_name_unique(
-		func_name,
-		nullptr,
-		nullptr,
-		nullptr,
-		&state.functions,
-		context,
-		&state.libraries,
-		error
-	);
+	is_name_unique(func_name, state.names, error);
 	rethrow_error();
 
 	handles_common::func(func_name, source, context, state, error);
 	rethrow_error();
+
+	if (context.lazy_libraries)
+	{
+		auto& func_def = state.functions.recent().second;
+		func_def.lazy_body = true;
+		func_def.lazy_body_begin = state.iterator;
+	}
 }
 
 void library_keywords_handles::_return
-(const std::string& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, library_parsing_state& state, std::string& error)
 {
 	handles_common::_return(source, context, state, error);
 }
@@ -0,0 +1,133 @@
+#pragma once
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+	Read only mapping of the whole file; the file itself is closed right after mapping, only the mapping is kept
+	Empty files cannot be mapped, so they are opened with no data
+*/
+matl::mapped_file::mapped_file(const std::string& path)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size))
+	{
+		CloseHandle(file);
+		return;
+	}
+
+	if (file_size.QuadPart != 0)
+	{
+		HANDLE file_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const void* view = file_mapping != nullptr ? MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+		if (view == nullptr)
+		{
+			if (file_mapping != nullptr) CloseHandle(file_mapping);
+			CloseHandle(file);
+			return;
+		}
+
+		mapping = file_mapping;
+		data = static_cast<const char*>(view);
+		size = static_cast<size_t>(file_size.QuadPart);
+	}
+
+	CloseHandle(file);
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file == -1) return;
+
+	struct stat file_stat;
+	if (fstat(file, &file_stat) == -1)
+	{
+		::close(file);
+		return;
+	}
+
+	if (file_stat.st_size != 0)
+	{
+		void* view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+		if (view == MAP_FAILED)
+		{
+			::close(file);
+			return;
+		}
+
+		data = static_cast<const char*>(view);
+		size = static_cast<size_t>(file_stat.st_size);
+	}
+
+	::close(file);
+#endif
+
+	opened = true;
+}
+
+matl::mapped_file::~mapped_file()
+{
+	close();
+}
+
+matl::mapped_file::mapped_file(mapped_file&& other) noexcept
+	: data(other.data), size(other.size), opened(other.opened), mapping(other.mapping)
+{
+	other.data = nullptr;
+	other.size = 0;
+	other.opened = false;
+	other.mapping = nullptr;
+}
+
+matl::mapped_file& matl::mapped_file::operator=(mapped_file&& other) noexcept
+{
+	if (this == &other) return *this;
+
+	close();
+
+	data = other.data;
+	size = other.size;
+	opened = other.opened;
+	mapping = other.mapping;
+
+	other.data = nullptr;
+	other.size = 0;
+	other.opened = false;
+	other.mapping = nullptr;
+
+	return *this;
+}
+
+void matl::mapped_file::close()
+{
+	if (data != nullptr)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+		CloseHandle(static_cast<HANDLE>(mapping));
+#else
+		munmap(const_cast<char*>(data), size);
+#endif
+	}
+
+	data = nullptr;
+	size = 0;
+	opened = false;
+	mapping = nullptr;
+}
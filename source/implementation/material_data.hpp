@@ -2,6 +2,7 @@
 
 struct material_parsing_state
 {
+	//index of the current token
 	size_t iterator = 0;
 	int line_counter = 0;
 	int this_line_indentation_spaces = 0;
@@ -9,6 +10,7 @@ struct material_parsing_state
 	bool function_body = false;
 
 	std::list<std::string> errors;
+	std::list<std::string> warnings;
 
 	variables_collection variables;
 	parameters_collection parameters;
@@ -16,5 +18,91 @@ struct material_parsing_state
 	libraries_collection libraries;
 	heterogeneous_map<std::string, property_value, hgm_string_solver> properties;
 
+	//names declared in the material, and in the currently parsed function
+	names_scope names;
+	names_scope function_names;
+
 	std::shared_ptr<const parsed_domain> domain = nullptr;
-};
\ No newline at end of file
+
+	//clears the state, so it can be used to parse the next material (see matl::compile_session)
+	//collections are cleared in the order they would be destroyed in; their hash indexes keep their buckets
+	inline void reset()
+	{
+		iterator = 0;
+		line_counter = 0;
+		this_line_indentation_spaces = 0;
+		function_body = false;
+
+		errors.clear();
+		warnings.clear();
+
+		function_names.clear();
+		names.clear();
+		properties.clear();
+		libraries.clear();
+		functions.clear();
+		parameters.clear();
+		variables.clear();
+
+		domain = nullptr;
+	}
+};
+
+/*
+	variables_reachability stores which of the material's variables are reachable from each variable and property
+	it is computed once per emission, so every dump variables directive and stage cost estimate is answered with bitwise ORs
+	variables are identified by variable_definition::index; each row is a bitset of the given amount of words
+	- variables : material's variables by their index
+	- rows : row i marks variables used, directly or not, by the variable i
+	- properties_rows : rows of the properties values, computed on the first use of the property
+*/
+struct variables_reachability
+{
+	size_t words = 0;
+
+	std::vector<named_variable*> variables;
+	std::vector<uint64_t> rows;
+	std::unordered_map<const expression*, std::vector<uint64_t>> properties_rows;
+
+	inline void clear()
+	{
+		words = 0;
+		variables.clear();
+		rows.clear();
+		properties_rows.clear();
+	}
+};
+
+//containers used while emitting the material; can be kept between materials to reuse their memory (see matl::compile_session)
+struct translation_buffers
+{
+	inlined_variables inlined;
+	std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions;
+
+	variables_reachability reachability;
+	std::vector<expression*> dumped_values;
+	std::vector<uint64_t> dumped_variables;
+	std::vector<uint32_t> variables_uses;
+	counting_set<function_instance*> functions;
+	std::unordered_set<const named_variable*> walked_variables;
+
+	std::unordered_set<const named_parameter*> used_parameters;
+	std::unordered_map<const named_parameter*, uint32_t> block_offsets;
+
+	std::vector<expression*> stage_properties;
+
+	inline void clear()
+	{
+		inlined.clear();
+		current_symbols_definitions.clear();
+		reachability.clear();
+		dumped_values.clear();
+		dumped_variables.clear();
+		variables_uses.clear();
+		functions.clear();
+		walked_variables.clear();
+		used_parameters.clear();
+		block_offsets.clear();
+		stage_properties.clear();
+	}
+};
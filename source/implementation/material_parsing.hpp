@@ -1,7 +1,7 @@
 #pragma once
 
 using material_keyword_handle = void(*)(
-	const std::string& material_source,
+	const tokenized_source& material_source,
 	context_public_implementation& context,
 	material_parsing_state& state,
 	std::string& error
@@ -9,11 +9,11 @@ using material_keyword_handle = void(*)(
 
 namespace material_keywords_handles
 {
-	void let(const std::string&, context_public_implementation&, material_parsing_state&, std::string&);
-	void property(const std::string&, context_public_implementation&, material_parsing_state&, std::string&);
-	void _using(const std::string&, context_public_implementation&, material_parsing_state&, std::string&);
-	void func(const std::string&, context_public_implementation&, material_parsing_state&, std::string&);
-	void _return(const std::string&, context_public_implementation&, material_parsing_state&, std::string&);
+	void let(const tokenized_source&, context_public_implementation&, material_parsing_state&, std::string&);
+	void property(const tokenized_source&, context_public_implementation&, material_parsing_state&, std::string&);
+	void _using(const tokenized_source&, context_public_implementation&, material_parsing_state&, std::string&);
+	void func(const tokenized_source&, context_public_implementation&, material_parsing_state&, std::string&);
+	void _return(const tokenized_source&, context_public_implementation&, material_parsing_state&, std::string&);
 }
 
 heterogeneous_map<std::string, material_keyword_handle, hgm_string_solver> keywords_handles_map =
@@ -27,34 +27,60 @@ heterogeneous_map<std::string, material_keyword_handle, hgm_string_solver> keywo
 	}
 };
 
-matl::parsed_material matl::parse_material(const std::string& material_source, matl::context* context)
+//validates the variable which validation was deferred, along with the deferred variables it uses
+//errors are reported at the lines of the variables definitions, into the errors list
+void validate_deferred_variable(named_variable* var, material_parsing_state& state, std::list<std::string>& errors)
 {
-	if (context == nullptr)
-	{
-		parsed_material returned_value;
-		returned_value.success = false;
-		returned_value.errors = { "[0] Cannot parse material without context" };
-		return returned_value;
-	}
+	auto& var_def = var->second;
+	if (!var_def.deferred) return;
 
-	material_parsing_state state;
+	var_def.deferred = false;
 
-	auto& context_impl = context->impl->impl;
+	for (auto& used : var_def.value->used_variables)
+		validate_deferred_variable(used, state, errors);
 
-	while (!is_at_source_end(material_source, state.iterator))
-	{
-		state.line_counter++;
+	std::string error;
+	var_def.type = validate_expression(var_def.value, state.domain, error);
 
-		std::string error;
+	if (error != "")
+		errors.push_back('[' + std::to_string(var_def.definition_line) + "] " + error);
+}
+
+//validates deferred variables used by the expression
+inline void validate_deferred_variables(const expression* exp, material_parsing_state& state, std::list<std::string>& errors)
+{
+	for (auto& var : exp->used_variables)
+		validate_deferred_variable(var, state, errors);
+}
+
+//parses the material into the state, without emitting shader code
+//all errors are reported into state.errors
+//tokens : tokens array reused between calls, nullptr to use a temporary one
+void parse_material_implementation(
+	const source_view& material_source, 
+	context_public_implementation& context, 
+	material_parsing_state& state, 
+	tokenized_source* tokens = nullptr
+)
+{
+	state.names.set_parent(&context.common_names);
+
+	tokenized_source temporary_tokens;
+	if (tokens == nullptr) tokens = &temporary_tokens;
+
+	auto& source = *tokens;
+	tokenize_source(material_source, source);
+
+	auto& iterator = state.iterator;
 
-		auto& source = material_source;
-		auto& iterator = state.iterator;
+	while (!is_at_source_end(source, iterator))
+	{
+		std::string error;
 
-		int spaces = get_spaces(source, iterator);
-		if (is_at_source_end(material_source, state.iterator)) break;
+		auto& line = source.at(iterator++);
+		state.line_counter = line.line;
 
-		if (source.at(iterator) == comment_char) goto _parse_material_next_line;
-		if (is_at_line_end(source, iterator)) goto _parse_material_next_line;
+		int spaces = line.indentation;
 
 		if (state.function_body)
 		{
@@ -99,21 +125,16 @@ matl::parsed_material matl::parse_material(const std::string& material_source, m
 				goto _parse_material_handle_error;
 			}
 
-			kh_itr->second(material_source, context_impl, state, error);
+			kh_itr->second(source, context, state, error);
 			if (error != "") goto _parse_material_handle_error;
 		}
 
-	_parse_material_next_line:
-		if (is_at_source_end(material_source, state.iterator)) break;
-		get_to_new_line(material_source, state.iterator);
-
+		get_to_new_line(source, iterator);
 		continue;
 
 	_parse_material_handle_error:
 		state.errors.push_back('[' + std::to_string(state.line_counter) + "] " + std::move(error));
-
-		if (is_at_source_end(material_source, state.iterator)) break;
-		get_to_new_line(material_source, state.iterator);
+		get_to_new_line(source, iterator);
 	}
 
 	if (state.domain != nullptr)
@@ -121,333 +142,583 @@ matl::parsed_material matl::parse_material(const std::string& material_source, m
 			if (state.properties.find(prop.first) == state.properties.end())
 				state.errors.push_back("[0] Missing property: " + prop.first);
 
-	if (state.errors.size() != 0)
+	if (state.errors.size() == 0 && state.domain == nullptr)
+		state.errors.push_back("[0] Material does not specify the domain");
+
+	//variables that are still deferred are not used by any property
+	if (context.unused_variables_warnings)
+		for (auto& var : state.variables)
+			validate_deferred_variable(&var, state, state.warnings);
+}
+
+//whether the variable should be pasted into expressions using it, instead of being declared
+inline bool should_inline_variable(const named_variable* var, const uint32_t& uses_count)
+{
+	return
+		var->second.value->cases.size() == 1 &&								//variables does not contain ifs
+		(																	//and
+			uses_count <= 1 												//variables is used only once 
+			||																//or
+			var->second.value->cases.front()->value->nodes.size() == 1		//it is made of a single node
+		);
+}
+
+//sort variables in order of their definitions
+//order : filled with the sorted variables
+inline void sort_variables(counting_set<named_variable*>& variables, std::vector<std::pair<named_variable*, uint32_t>*>& order)
+{
+	order.clear();
+
+	for (auto itr = variables.begin(); itr != variables.end(); itr++)
+		order.push_back(&(*itr));
+
+	std::sort(order.begin(), order.end(), [](std::pair<named_variable*, uint32_t>* const& a, std::pair<named_variable*, uint32_t>* const& b)
+		{
+			return a->first->second.definition_line < b->first->second.definition_line;
+		});
+}
+
+//get the translation of the function instance; translation is cached inside the instance, separately for each translator
+inline const std::string& translate_function_instance(
+	function_instance* instance,
+	const translator* translator,
+	const std::unordered_map<const symbol_definition*, size_t>& current_symbols_definitions
+)
+{
+	auto lock = lock_function_instances(*instance->function);
+
+	auto& function_traslation = instance->translated[translator];
+
+	if (function_traslation.size() != 0)
+		return function_traslation;
+
+	function_traslation.reserve(512);
+
+	inlined_variables inlined_function_vars;
+	size_t instance_index = 0;
+
+	auto instances_itr = instance->function->instances.begin();
+	while (&*instances_itr != instance)
+		{ instances_itr++; instance_index++; }
+
+	counting_set<named_variable*> variables;
+	get_used_variables_recursive(instance->function->returned_value, variables);
+
+	function_traslation += translator->function_header_translator(instance);
+
+	std::vector<std::pair<named_variable*, uint32_t>*> order;
+	sort_variables(variables, order);
+
+	for (auto var_itr = order.begin(); var_itr != order.end(); var_itr++)
 	{
-		parsed_material material;
-		material.success = false;
-		material.errors = std::move(state.errors);
-		return material;
+		auto& variable_name = (*var_itr)->first->first;
+		auto& variable = (*var_itr)->first->second;
+		auto& used_functions = (*var_itr)->first->second.value->used_functions.at(instance_index);
+
+		if (should_inline_variable((*var_itr)->first, (*var_itr)->second))
+		{
+			inlined_function_vars.insert({
+				(*var_itr)->first,
+				"(" + translator->expression_translator(
+					variable.value, &inlined_function_vars, used_functions, current_symbols_definitions, nullptr) + ")"
+			});
+		}
+		else
+		{
+			function_traslation += translator->variables_declarations_translator(
+				variable_name, &variable, &inlined_function_vars, used_functions, current_symbols_definitions, nullptr);
+		}
+	};
+
+	auto& used_functions = instance->function->returned_value->used_functions;
+	function_traslation += translator->function_return_statement_translator(
+		instance,
+		inlined_function_vars,
+		used_functions.at(instance_index)
+	);
+
+	return function_traslation;
+}
+
+//fill parameter info returned to the client
+inline void get_parameter_info(const named_parameter& param, matl::parsed_material::parameter& param_info)
+{
+	using parsed_material = matl::parsed_material;
+
+	param_info.name = param.first;
+
+	if (param.second.type == scalar_data_type)
+		param_info.type = parsed_material::parameter::type::scalar;
+	else if (param.second.type == bool_data_type)
+		param_info.type = parsed_material::parameter::type::boolean;
+	else if (param.second.type == texture_data_type)
+		param_info.type = parsed_material::parameter::type::texture;
+	else if (param.second.default_value_numeric.size() == 2)
+		param_info.type = parsed_material::parameter::type::vector2;
+	else if (param.second.default_value_numeric.size() == 3)
+		param_info.type = parsed_material::parameter::type::vector3;
+	else if (param.second.default_value_numeric.size() == 4)
+		param_info.type = parsed_material::parameter::type::vector4;
+
+	param_info.texture_default_value = param.second.default_value_texture;
+	param_info.numeric_default_value = param.second.default_value_numeric;
+}
+
+//fill parameters infos of the material, along with their offsets inside the parameters block
+//block_offsets : buffer for parameters offsets lookup
+inline void get_parameters_info(
+	matl::parsed_material& material,
+	const parameters_collection& parameters,
+	const parameters_block_layout& parameters_block,
+	std::unordered_map<const named_parameter*, uint32_t>& block_offsets
+)
+{
+	for (size_t i = 0; i < parameters_block.members.size(); i++)
+		block_offsets.insert({ parameters_block.members.at(i), parameters_block.offsets.at(i) });
+
+	material.parameters_block_size = parameters_block.size;
+
+	for (auto& param : parameters)
+	{
+		material.parameters.push_back({});
+		auto& param_info = material.parameters.back();
+
+		auto offset_itr = block_offsets.find(&param);
+		if (offset_itr != block_offsets.end())
+			param_info.block_offset = offset_itr->second;
+
+		get_parameter_info(param, param_info);
+	}
+}
+
+//parameters used by the expression and all of the variables it uses
+//walked : variables already walked, so each variable is walked once
+inline void get_used_parameters_recursive(
+	const expression* exp, 
+	std::unordered_set<const named_parameter*>& used, 
+	std::unordered_set<const named_variable*>& walked
+)
+{
+	for (auto& exp_case : exp->cases)
+		for (auto& single : { exp_case->condition, exp_case->value })
+		{
+			if (single == nullptr) continue;
+
+			for (auto& node : single->nodes)
+				if (node->get_type() == expression::node::node_type::parameter)
+					used.insert(node->as_parameter());
+		}
+
+	for (auto& var : exp->used_variables)
+		if (var->second.value != nullptr && walked.insert(var).second)
+			get_used_parameters_recursive(var->second.value, used, walked);
+}
+
+//emits the domain's directives into the sources, one source per stage
+//directives that depend on the emitted material(s) are emitted by the handles:
+//dump_property, dump_variables and dump_functions are given the directive, dump_parameters and end_stage take no arguments
+//end_stage is called at each split, before the next source is started
+template<class property_handle, class variables_handle, class functions_handle, class parameters_handle, class stage_handle>
+inline void emit_domain_directives(
+	const parsed_domain& domain,
+	const context_public_implementation& context_impl,
+	std::list<std::string>& sources,
+	std::unordered_map<const symbol_definition*, size_t>& current_symbols_definitions,
+	property_handle&& dump_property,
+	variables_handle&& dump_variables,
+	functions_handle&& dump_functions,
+	parameters_handle&& dump_parameters,
+	stage_handle&& end_stage
+)
+{
+	constexpr auto preallocated_shader_memory = 5 * 1024;
+
+	sources = { "" };
+	sources.back().reserve(preallocated_shader_memory);
+
+	for (auto& symbol : domain.symbols)
+		current_symbols_definitions.insert({ &symbol.second, 0 });
+
+	for (auto& directive : domain.directives)
+	{
+		switch (directive.type)
+		{
+		case directive_type::dump_block:
+			sources.back().append(directive.text.data(), directive.text.size());
+			break;
+		case directive_type::dump_insertion:
+			sources.back() += context_impl.domain_insertions.at(directive.payload.at(0));
+			break;
+		case directive_type::dump_property:
+			dump_property(directive);
+			break;
+		case directive_type::dump_variables:
+			dump_variables(directive);
+			break;
+		case directive_type::dump_functions:
+			dump_functions(directive);
+			break;
+		case directive_type::dump_parameters:
+			dump_parameters();
+			break;
+		case directive_type::split:
+			end_stage();
+			sources.push_back("");
+			sources.back().reserve(preallocated_shader_memory);
+			break;
+		case directive_type::change_symbol_definition:
+		{
+			auto symbol = &domain.symbols.at(directive.payload.at(0));
+			current_symbols_definitions.at(symbol)++;
+			break;
+		}
+		default:
+			break;
+		}
 	}
+}
+
+//emits the shader code of the parsed material
+//translator : target language translator, one of the context's targets
+//fallbacks : properties that should be replaced with the domain's fallbacks, nullptr to use material's values only
+//when fallbacks are used, parameters that are no longer reachable are not dumped
+//buffers : containers reused between calls, nullptr to use temporary ones
+matl::parsed_material translate_material(
+	material_parsing_state& state, 
+	context_public_implementation& context_impl, 
+	const translator* translator,
+	const std::list<std::string>* fallbacks,
+	translation_buffers* buffers = nullptr
+)
+{
+	using parsed_material = matl::parsed_material;
 
-	if (state.domain == nullptr)
+	translation_buffers temporary_buffers;
+	if (buffers == nullptr) buffers = &temporary_buffers;
+	buffers->clear();
+
+	if (fallbacks != nullptr)
+		for (auto& fallback : *fallbacks)
+			if (state.domain->properties_fallbacks.find(fallback) == state.domain->properties_fallbacks.end())
+			{
+				parsed_material material;
+				material.success = false;
+				material.errors = { "[0] Domain does not provide fallback for property: " + fallback };
+				return material;
+			}
+
+	bool packed_parameters = state.domain->parameters_layout != parameters_layout_type::separate;
+
+	if (packed_parameters && translator->parameters_block_translator == nullptr)
 	{
 		parsed_material material;
 		material.success = false;
-		material.errors = { "[0] Material does not specify the domain" };
+		material.errors = { "[0] Target language does not support packed parameters" };
 		return material;
 	}
 
+	auto get_property_value = [&](const std::string& property_name) -> expression*
+	{
+		if (fallbacks != nullptr && std::find(fallbacks->begin(), fallbacks->end(), property_name) != fallbacks->end())
+			return state.domain->properties_fallbacks.at(property_name).value;
+		return state.properties.at(property_name).value;
+	};
+
+	const parameters_collection* parameters = &state.parameters;
+	parameters_collection reachable_parameters;
+
+	if (fallbacks != nullptr)
+	{
+		auto& used = buffers->used_parameters;
+		auto& walked = buffers->walked_variables;
+		walked.clear();
+
+		for (auto& prop : state.domain->properties)
+			get_used_parameters_recursive(get_property_value(prop.first), used, walked);
+
+		for (auto& param : state.parameters)
+			if (used.find(&param) != used.end())
+				reachable_parameters.insert({ param.first, param.second });
+
+		parameters = &reachable_parameters;
+	}
+
 	parsed_material material;
 	material.success = true;
-	material.sources = { "" };
+	material.warnings = state.warnings;
+	material.target_language = translator->language_name;
 
-	constexpr auto preallocated_shader_memory = 5 * 1024;
+	parameters_block_layout parameters_block;
+	if (packed_parameters)
+		parameters_block = get_parameters_block_layout(*parameters, state.domain->parameters_layout);
 
-	material.sources.back().reserve(preallocated_shader_memory);
+	auto& inlined = buffers->inlined;
+	auto& current_symbols_definitions = buffers->current_symbols_definitions;
 
-	auto& translator = context->impl->impl._translator;
+	auto& reachability = buffers->reachability;
+	build_variables_reachability(state.variables, reachability);
 
-	inlined_variables inlined;
-	std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions;
+	cost_estimator estimator(context_impl);
+	auto& stage_properties = buffers->stage_properties;
 
-	for (auto& symbol : state.domain->symbols)
-		current_symbols_definitions.insert({ &symbol.second, 0 });
+	auto estimate_stage = [&]()
+	{
+		material.stages_costs.push_back(estimator.estimate(stage_properties, reachability));
+		stage_properties.clear();
+
+		if (context_impl.cost_budget != 0 && material.stages_costs.back().weighted_cost > context_impl.cost_budget)
+			material.over_budget = true;
+	};
 
 	auto dump_property = [&](const directive& directive)
 	{
-		auto& property = state.properties.at(directive.payload.at(0));
+		auto property_value = get_property_value(directive.payload.at(0));
+		stage_properties.push_back(property_value);
 
 		material.sources.back() += '(';
 		material.sources.back() += translator->expression_translator(
-			property.value,
+			property_value,
 			&inlined,
-			property.value->used_functions.at(0),
-			current_symbols_definitions
+			property_value->used_functions.at(0),
+			current_symbols_definitions,
+			state.domain.get()
 		);
 		material.sources.back() += ')';
 	};
 
-	auto should_inline_variable = [&](const named_variable* var, const uint32_t& uses_count) -> bool
-	{
-		return
-			var->second.value->cases.size() == 1 &&								//variables does not contain ifs
-			(																	//and
-				uses_count <= 1 												//variables is used only once 
-				||																//or
-				var->second.value->cases.front()->value->nodes.size() == 1		//it is made of a single node
-			);
-	};
-
-	auto sort_variables = [&](counting_set<named_variable*>& variables)
-	{
-		std::vector<std::pair<named_variable*, uint32_t>*> order;
-
-		for (auto itr = variables.begin(); itr != variables.end(); itr++)
-			order.push_back(&(*itr));
-
-		std::sort(order.begin(), order.end(), [](std::pair<named_variable*, uint32_t>* const& a, std::pair<named_variable*, uint32_t>* const& b)
-			{
-				return a->first->second.definition_line < b->first->second.definition_line;
-			});
-
-		return order;
-	};
-
 	auto dump_variables = [&](const directive& directive)
 	{
-		counting_set<named_variable*> variables;
+		auto& variables = reachability.variables;
+		auto& values = buffers->dumped_values;
+		auto& dumped = buffers->dumped_variables;
+		auto& uses = buffers->variables_uses;
 
+		values.clear();
 		for (auto& prop : directive.payload)
-		{
-			const auto& prop_exp = state.properties.at(prop).value;
-			get_used_variables_recursive(prop_exp, variables);
-		}
+			values.push_back(get_property_value(prop));
 
-		auto order = sort_variables(variables);
+		get_dumped_variables(reachability, values, dumped, uses);
 
-		for (auto var_itr = order.begin(); var_itr != order.end(); var_itr++)
+		//variables indices follow their definition order
+		for (size_t index = 0; index < variables.size(); index++)
 		{
-			auto& variable_name = (*var_itr)->first->first;
-			auto& variable = (*var_itr)->first->second;
+			if (!is_variable_reachable(dumped, index)) continue;
+
+			auto& variable_name = variables[index]->first;
+			auto& variable = variables[index]->second;
 			auto& used_functions = variable.value->used_functions.at(0);
 
-			if (should_inline_variable((*var_itr)->first, (*var_itr)->second))
+			if (should_inline_variable(variables[index], uses[index]))
 			{
 				inlined.insert({
-					(*var_itr)->first,
-					"(" + translator->expression_translator(variable.value, &inlined, used_functions, current_symbols_definitions)+ ")"
+					variables[index],
+					"(" + translator->expression_translator(variable.value, &inlined, used_functions, current_symbols_definitions, state.domain.get()) + ")"
 				});
 			}
 			else
 			{
 				material.sources.back() += translator->variables_declarations_translator(
-					variable_name, &variable, &inlined, used_functions, current_symbols_definitions);
+					variable_name, &variable, &inlined, used_functions, current_symbols_definitions, state.domain.get());
 			}
 		};
 	};
 
 	auto dump_functions = [&](const directive& directive)
 	{
-		counting_set<function_instance*> functions;
+		auto& functions = buffers->functions;
+		auto& walked = buffers->walked_variables;
+		functions.clear();
+		walked.clear();
 
 		for (auto& prop : directive.payload)
-		{
-			const auto& prop_exp = state.properties.at(prop).value;
-			get_used_functions_recursive(prop_exp, functions);
-		}
+			get_used_functions_recursive(get_property_value(prop), functions, walked);
 
 		for (auto func_itr = functions.begin(); func_itr != functions.end(); func_itr++)
 		{
-			inlined_variables inlined_function_vars;
-			size_t instance_index = 0;
-
-			auto instances_itr = func_itr->first->function->instances.begin();
-			while (&*instances_itr != func_itr->first)
-				{ instances_itr++; instance_index++; }
+			if (func_itr->first->function->is_exposed) continue;
+			material.sources.back() += translate_function_instance(func_itr->first, translator, current_symbols_definitions);
+		}
+	};
 
-			if ((*func_itr).first->function->is_exposed) continue;
+	auto dump_parameters = [&]()
+	{
+		if (packed_parameters && parameters_block.members.size() != 0)
+			material.sources.back() += translator->parameters_block_translator(parameters_block, state.domain->parameters_layout);
 
-			auto& function_traslation = (*func_itr).first->translated;
+		for (auto& parameter : *parameters)
+			if (!packed_parameters || parameter.second.type == texture_data_type)
+				material.sources.back() += translator->parameters_declarations_translator(parameter.first, &parameter.second);
+	};
 
-			if (function_traslation.size() != 0)
-			{
-				material.sources.back() += (*func_itr).first->translated;
-				continue;
-			}
-			function_traslation.reserve(512);
+	emit_domain_directives(
+		*state.domain, context_impl, material.sources, current_symbols_definitions,
+		dump_property, dump_variables, dump_functions, dump_parameters, estimate_stage
+	);
 
-			counting_set<named_variable*> variables;
-			get_used_variables_recursive(func_itr->first->function->returned_value, variables);
+	estimate_stage();
 
-			function_traslation += translator->function_header_translator(func_itr->first);
+	get_parameters_info(material, *parameters, parameters_block, buffers->block_offsets);
 
-			auto order = sort_variables(variables);
+	return material;
+}
 
-			for (auto var_itr = order.begin(); var_itr != order.end(); var_itr++)
-			{
-				auto& variable_name = (*var_itr)->first->first;
-				auto& variable = (*var_itr)->first->second;
-				auto& used_functions = (*var_itr)->first->second.value->used_functions.at(instance_index);
-
-				if (should_inline_variable((*var_itr)->first, (*var_itr)->second))
-				{
-					inlined_function_vars.insert({
-						(*var_itr)->first,
-						"(" + translator->expression_translator(
-							variable.value, &inlined_function_vars, used_functions, current_symbols_definitions) + ")"
-					});
-				}
-				else
-				{
-					function_traslation += translator->variables_declarations_translator(
-						variable_name, &variable, &inlined_function_vars, used_functions, current_symbols_definitions);
-				}
-			};
-
-			auto& used_functions = func_itr->first->function->returned_value->used_functions;
-			function_traslation += translator->function_return_statement_translator(
-				func_itr->first, 
-				inlined_function_vars, 
-				used_functions.at(instance_index)
-			);
-
-			material.sources.back() += function_traslation;
-		}
-	};
+matl::parsed_material matl::parse_material(const std::string& material_source, matl::context* context)
+{
+	return parse_material(source_view(material_source), context);
+}
 
-	auto dump_parameters = [&]()
+//parses the material into the state; shared by all entry points that parse a single material
+//context : implementation of the context passed to the entry point, nullptr if none was passed
+//failure : if parsing fails, it is filled with the errors and warnings, ready to be returned
+//tokens : tokens array reused between calls, nullptr to use a temporary one
+//returns whether the material was parsed without errors
+bool parse_material_state(
+	const source_view& material_source, 
+	context_public_implementation* context, 
+	material_parsing_state& state, 
+	matl::parsed_material& failure,
+	tokenized_source* tokens = nullptr
+)
+{
+	if (context == nullptr)
 	{
-		for (auto& parameter : state.parameters)
-			material.sources.back() += translator->parameters_declarations_translator(parameter.first, &parameter.second);
-	};
+		failure.success = false;
+		failure.errors = { "[0] Cannot parse material without context" };
+		return false;
+	}
 
-	for (auto& directive : state.domain->directives)
-	{
-		using directive_type = directive_type;
+	parse_material_implementation(material_source, *context, state, tokens);
 
-		switch (directive.type)
-		{
-		case directive_type::dump_block:
-			material.sources.back() += directive.payload.at(0);
-			break;
-		case directive_type::dump_insertion:
-			material.sources.back() += context_impl.domain_insertions.at(directive.payload.at(0));
-			break;
-		case directive_type::dump_property:
-			dump_property(directive);
-			break;
-		case directive_type::dump_variables:
-			dump_variables(directive);
-			break;
-		case directive_type::dump_functions:
-			dump_functions(directive);
-			break;
-		case directive_type::dump_parameters:
-			dump_parameters();
-			break;
-		case directive_type::split:
-			material.sources.push_back("");
-			material.sources.back().reserve(preallocated_shader_memory);
-			break;
-		case directive_type::change_symbol_definition:
-			auto& symbol_name = directive.payload.at(0);
-			auto symbol = &state.domain->symbols.at(symbol_name);
-			current_symbols_definitions.at(symbol)++;
-			break;
-		}
+	if (state.errors.size() != 0)
+	{
+		failure.success = false;
+		failure.errors = std::move(state.errors);
+		failure.warnings = std::move(state.warnings);
+		return false;
 	}
 
-	for (auto& param : state.parameters)
-	{
-		material.parameters.push_back({});
-		auto& param_info = material.parameters.back();
+	return true;
+}
 
-		param_info.name = std::move(param.first);
-
-		if (param.second.type == scalar_data_type)
-			param_info.type = parsed_material::parameter::type::scalar;
-		else if (param.second.type == bool_data_type)
-			param_info.type = parsed_material::parameter::type::boolean;
-		else if (param.second.type == texture_data_type)
-			param_info.type = parsed_material::parameter::type::texture;
-		else if (param.second.default_value_numeric.size() == 2)
-			param_info.type = parsed_material::parameter::type::vector2;
-		else if (param.second.default_value_numeric.size() == 3)
-			param_info.type = parsed_material::parameter::type::vector3;
-		else if (param.second.default_value_numeric.size() == 4)
-			param_info.type = parsed_material::parameter::type::vector4;
-
-		param_info.texture_default_value = std::move(param.second.default_value_texture);
-		param_info.numeric_default_value = std::move(param.second.default_value_numeric);
-	}
+matl::parsed_material matl::parse_material(const source_view& material_source, matl::context* context)
+{
+	material_parsing_state state;
+	parsed_material failure;
+
+	if (!parse_material_state(material_source, context == nullptr ? nullptr : &context->impl->impl, state, failure))
+		return failure;
+
+	auto& context_impl = context->impl->impl;
+	return translate_material(state, context_impl, context_impl._translator, nullptr);
+}
+
+std::list<matl::parsed_material> matl::parse_material_variants(
+	const std::string& material_source, 
+	const std::list<std::list<std::string>>& variants_fallbacks, 
+	matl::context* context
+)
+{
+	material_parsing_state state;
+	parsed_material failure;
+
+	if (!parse_material_state(material_source, context == nullptr ? nullptr : &context->impl->impl, state, failure))
+		return { failure };
+
+	auto& context_impl = context->impl->impl;
+	std::list<parsed_material> variants;
+
+	for (auto& fallbacks : variants_fallbacks)
+		variants.push_back(translate_material(state, context_impl, context_impl._translator, &fallbacks));
+
+	return variants;
+}
+
+std::list<matl::parsed_material> matl::parse_material_targets(const std::string& material_source, matl::context* context)
+{
+	material_parsing_state state;
+	parsed_material failure;
+
+	if (!parse_material_state(material_source, context == nullptr ? nullptr : &context->impl->impl, state, failure))
+		return { failure };
+
+	auto& context_impl = context->impl->impl;
+	std::list<parsed_material> targets;
+
+	for (auto& target : context_impl.targets)
+		targets.push_back(translate_material(state, context_impl, target.second, nullptr));
+
+	return targets;
+}
+
+matl::parsed_material matl::check_material(const std::string& material_source, matl::context* context)
+{
+	material_parsing_state state;
+	parsed_material material;
+
+	if (!parse_material_state(material_source, context == nullptr ? nullptr : &context->impl->impl, state, material))
+		return material;
+
+	material.success = true;
+	material.warnings = std::move(state.warnings);
+
+	parameters_block_layout parameters_block;
+	if (state.domain->parameters_layout != parameters_layout_type::separate)
+		parameters_block = get_parameters_block_layout(state.parameters, state.domain->parameters_layout);
+
+	std::unordered_map<const named_parameter*, uint32_t> block_offsets;
+	get_parameters_info(material, state.parameters, parameters_block, block_offsets);
 
 	return material;
 }
 
 void material_keywords_handles::let
-(const std::string& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
 {
 	auto& iterator = state.iterator;
 
-	get_spaces(source, iterator);
 	auto var_name = get_string_ref(source, iterator, error);
 	rethrow_error();
 
-	is_name_unique(
-		var_name,
-		&state.variables,
-		&state.domain->symbols,
-		&state.parameters,
-		&state.functions,
-		context,
-		&state.libraries,
-		error
-	);
+	is_name_unique(var_name, state.function_body ? state.function_names : state.names, error);
 	rethrow_error();
 
-	get_spaces(source, iterator);
-	auto assign_operator = get_char(source, iterator);
-
-	if (assign_operator != '=')
+	if (!get_operator(source, iterator, "="))
 		error = "Expected '='";
 
 	rethrow_error();
 
-	throw_error(state.functions.find(var_name) != state.functions.end(),
-		"Function named " + std::string(var_name) + " already exists");
-
 	if (!state.function_body)
 	{
-		is_name_unique(
-			var_name, 
-			&state.variables, 
-			&state.domain->symbols, 
-			&state.parameters, 
-			&state.functions, 
-			context,
-			&state.libraries, 
-			error
-		);
-		rethrow_error();
+		auto& var = *state.variables.insert({ var_name, {} });
+		state.names.declare(var_name, scope_entity::new_variable(&var));
 
-		auto& var_def = state.variables.insert({ var_name, {} })->second;
+		auto& var_def = var.second;
 		var_def.definition_line = state.line_counter;
+		var_def.index = static_cast<uint32_t>(state.variables.size() - 1);
 
 		var_def.value = get_expression(
 			source,
 			iterator,
 			state.this_line_indentation_spaces,
 			state.line_counter,
-			&state.variables,
-			&state.parameters,
-			&state.functions,
-			&state.libraries,
+			&state.names,
 			context,
 			state.domain,
+			context.deferred_variables_validation ? nullptr : &var_def.type,
 			error
 		);
 		rethrow_error();
 
-		var_def.type = validate_expression(var_def.value, state.domain, error);
-		rethrow_error();
+		var_def.deferred = context.deferred_variables_validation;
 	}
 	else
 	{
 		auto& func_def = state.functions.recent().second;
 
-		is_name_unique(
-			var_name,
-			&func_def.variables,
-			nullptr,
-			nullptr,
-			&state.functions,
-			context,
-			&state.libraries,
-			error
-		);
-		rethrow_error();
+		auto& var = *func_def.variables.insert({ var_name, {} });
+		state.function_names.declare(var_name, scope_entity::new_variable(&var));
 
-		auto& var_def = func_def.variables.insert({ var_name, {} })->second;
+		auto& var_def = var.second;
 		var_def.definition_line = state.line_counter;
 
 		var_def.value = get_expression(
@@ -455,12 +726,10 @@ void material_keywords_handles::let
 			iterator,
 			state.this_line_indentation_spaces,
 			state.line_counter,
-			&func_def.variables,
-			nullptr,
-			&state.functions,
-			&state.libraries,
+			&state.function_names,
 			context,
 			nullptr,
+			nullptr,
 			error
 		);
 		if (error != "") func_def.valid = false;
@@ -469,20 +738,17 @@ void material_keywords_handles::let
 }
 
 void material_keywords_handles::property
-(const std::string& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
 {
 	throw_error(state.domain == nullptr, "Cannot use property since the domain has not yet been specified");
 	throw_error(state.function_body, "Cannot use property in this scope");
 
 	auto& iterator = state.iterator;
 
-	get_spaces(source, iterator);
 	auto property_name = get_string_ref(source, iterator, error);
 	rethrow_error();
 
-	get_spaces(source, iterator);
-	auto assign_operator = get_char(source, iterator);
-	throw_error(assign_operator != '=', "Expected '='");
+	throw_error(!get_operator(source, iterator, "="), "Expected '='");
 
 	auto itr = state.domain->properties.find(property_name);
 	throw_error(itr == state.domain->properties.end(), "No such property: " + std::string(property_name));
@@ -490,37 +756,45 @@ void material_keywords_handles::property
 	throw_error(state.properties.find(property_name) != state.properties.end(),
 		"Equation for property " + std::string(property_name) + " is already specified");
 
+	const data_type* type = nullptr;
+
 	auto& prop = state.properties.insert({ property_name, {} })->second;
 	prop.value = get_expression(
 		source,
 		iterator,
 		state.this_line_indentation_spaces,
 		state.line_counter,
-		&state.variables,
-		&state.parameters,
-		&state.functions,
-		&state.libraries,
+		&state.names,
 		context,
 		state.domain,
+		context.deferred_variables_validation ? nullptr : &type,
 		error
 	);
 	rethrow_error();
 
-	auto type = validate_expression(prop.value, state.domain, error);
-	rethrow_error();
+	//used variables types are known only after they are validated, so the property is validated afterwards
+	if (context.deferred_variables_validation)
+	{
+		validate_deferred_variables(prop.value, state, state.errors);
+
+		for (auto& var : prop.value->used_variables)
+			throw_error(var->second.type == nullptr, "Cannot use invalid variable: " + var->first);
+
+		type = validate_expression(prop.value, state.domain, error);
+		rethrow_error();
+	}
 
 	if (itr->second != type)
 		error = "Invalid property type; expected: " + itr->second->name + " got: " + type->name;
 }
 
 void material_keywords_handles::_using
-(const std::string& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
 {
 	throw_error(state.function_body, "Cannot use using in this scope");
 
 	auto& iterator = state.iterator;
 
-	get_spaces(source, iterator);
 	auto using_type = get_string_ref(source, iterator, error);
 
 	rethrow_error();
@@ -529,96 +803,88 @@ void material_keywords_handles::_using
 	{
 		throw_error(state.domain != nullptr, "Domain is already specified");
 
-		get_spaces(source, iterator);
 		auto domain_name = get_rest_of_line(source, iterator);
 		auto itr = context.domains.find(domain_name);
 
 		throw_error(itr == context.domains.end(), "No such domain: " + std::string(domain_name));
 
 		state.domain = itr->second;
+
+		for (auto& symbol : state.domain->symbols)
+			state.names.declare(symbol.first, scope_entity::new_symbol(&symbol));
 	}
 	else if (using_type == "library")
 	{
-		get_spaces(source, iterator);
 		auto library_name = get_rest_of_line(source, iterator);
 
-		auto itr = context.libraries.find(library_name);
-		throw_error(itr == context.libraries.end(), "No such library: " + std::string(library_name));
+		std::list<matl::library_parsing_raport> raports;
+		std::shared_ptr<parsed_library> library;
+		get_library(library_name, context, std::make_shared<parsed_libraries_stack>(), raports, library, error);
+		rethrow_error();
 
-		state.libraries.insert({ library_name, itr->second });
+		auto& named_lib = *state.libraries.insert({ library_name, library });
+		state.names.declare(library_name, scope_entity::new_library(&named_lib));
 	}
 	else if (using_type == "parameter")
 	{
-		get_spaces(source, iterator);
 		auto parameter_name = get_string_ref(source, iterator, error);
 		rethrow_error();
 
-		get_spaces(source, iterator);
-		auto assign_operator = get_char(source, iterator);
-		throw_error(assign_operator != '=', "Expected '='");
+		throw_error(!get_operator(source, iterator, "="), "Expected '='");
 
-		is_name_unique(
-			parameter_name,
-			&state.variables,
-			&state.domain->symbols,
-			&state.parameters,
-			&state.functions,
-			context,
-			&state.libraries,
-			error
-		);
+		is_name_unique(parameter_name, state.names, error);
 		rethrow_error();
 
+		//parameter with invalid value is still declared (with no type), so its uses are reported as such
 		state.parameters.insert({ parameter_name, {} });
+		state.names.declare(parameter_name, scope_entity::new_parameter(&state.parameters.recent()));
 		auto& param_def = state.parameters.recent().second;
 
-		get_spaces(source, iterator);
+		size_t value_begin = iterator;
 		auto value = get_rest_of_line(source, iterator);
 
-		if (expressions_parsing_utilities::is_scalar_literal(value, error))
+		throw_error(value.size() == 0, "Expected parameter value");
+
+		bool negated_scalar = is_operator_token(source, value_begin, "-") && iterator == value_begin + 2;
+		auto& first_token = source.at(negated_scalar ? value_begin + 1 : value_begin);
+
+		if (first_token.kind == token_kind::scalar_literal && iterator == value_begin + (negated_scalar ? 2 : 1))
 		{
 			param_def.type = scalar_data_type;
-			param_def.default_value_numeric = { std::stof(value) };
-			rethrow_error();
+			param_def.default_value_numeric = { negated_scalar ? -first_token.literal_value : first_token.literal_value };
+			throw_error(value.at(value.size() - 1) == '.', "Invalid scalar literal: " + std::string(value));
 		}
-		else if (source.at(value.begin) == '(')
+		else if (is_operator_token(source, value_begin, "("))
 		{
-			iterator = value.begin + 1;
-			bool hitted_parentheses_end = false;
-			std::string buffer;
-			buffer.reserve(16);
+			//vector components are scalar literals, optionally negated
+			iterator = value_begin + 1;
+			bool hitted_parentheses_end = get_operator(source, iterator, ")");
 
-			while (!(is_at_line_end(source, iterator)))
+			while (!is_at_line_end(source, iterator))
 			{
-				auto& c = source.at(iterator);
-
-				if (c == ',')
-				{
-					expressions_parsing_utilities::is_scalar_literal(buffer, error);
-					rethrow_error();
-					param_def.default_value_numeric.push_back({ std::stof(buffer) });
-					buffer.clear();
-				}
-				else if (c == ')')
-				{
-					hitted_parentheses_end = true;
+				throw_error(hitted_parentheses_end, "Unexpected symbol after vector literal end");
+
+				bool negated = get_operator(source, iterator, "-");
+				if (is_at_line_end(source, iterator)) break;
 
-					expressions_parsing_utilities::is_scalar_literal(buffer, error);
-					rethrow_error();
-					param_def.default_value_numeric.push_back({ std::stof(buffer) });
-					buffer.clear();
-				}
-				else if (c == ' ' || c == '\t') {}
-				else
-				{
-					throw_error(hitted_parentheses_end, "Unexpected symbol after vector literal end");
-					buffer.push_back(c);
-				}
-
-				iterator++;
+				auto& component = source.at(iterator++);
+				auto component_str = source.get_string(component);
+
+				throw_error(component.kind != token_kind::scalar_literal || component_str.at(component_str.size() - 1) == '.',
+					"Invalid scalar literal: " + std::string(component_str));
+
+				param_def.default_value_numeric.push_back(negated ? -component.literal_value : component.literal_value);
+
+				if (get_operator(source, iterator, ")"))
+					hitted_parentheses_end = true;
+				else if (!is_at_line_end(source, iterator))
+					throw_error(!get_operator(source, iterator, ","), "Expected comma");
 			}
 
-			param_def.type = get_vector_type_of_size(static_cast<uint8_t>(param_def.default_value_numeric.size()));
+			auto size = param_def.default_value_numeric.size();
+			throw_error(size == 0 || size > 4, "Invalid vector size: " + std::to_string(size));
+
+			param_def.type = get_vector_type_of_size(static_cast<uint8_t>(size));
 
 			throw_error(!hitted_parentheses_end, "Mismatched parentheses");
 		}
@@ -633,30 +899,19 @@ void material_keywords_handles::_using
 		auto itr = context.custom_using_handles.find(using_type);
 		throw_error(itr == context.custom_using_handles.end(), "No such using case: " + std::string(using_type));
 
-		get_spaces(source, iterator);
 		auto arg = get_rest_of_line(source, iterator);;
 		itr->second(arg, error);
 	}
 }
 
 void material_keywords_handles::func
-(const std::string& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
 {
-	get_spaces(source, state.iterator);
 	std::string func_name = get_string_ref(source, state.iterator, error);
 	throw_error(func_name == "", "Expected function name");
 	rethrow_error();
 
-	is_name_unique(
-		func_name,
-		&state.variables,
-		&state.domain->symbols,
-		&state.parameters,
-		&state.functions,
-		context,
-		&state.libraries,
-		error
-	);
+	is_name_unique(func_name, state.names, error);
 	rethrow_error();
 
 	handles_common::func(func_name, source, context, state, error);
@@ -664,7 +919,7 @@ void material_keywords_handles::func
 }
 
 void material_keywords_handles::_return
-(const std::string& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
+(const tokenized_source& source, context_public_implementation& context, material_parsing_state& state, std::string& error)
 {
 	handles_common::_return(source, context, state, error);
 }
\ No newline at end of file
@@ -0,0 +1,276 @@
+#pragma once
+
+matl::merged_material matl::merge_materials(const std::list<std::string>& materials_sources, matl::context* context)
+{
+	merged_material merged;
+
+	if (context == nullptr)
+	{
+		merged.errors = { "[0] Cannot merge materials without context" };
+		return merged;
+	}
+
+	auto& context_impl = context->impl->impl;
+	auto& translator = context_impl._translator;
+
+	std::list<material_parsing_state> states;
+
+	for (auto& source : materials_sources)
+	{
+		states.emplace_back();
+		auto& state = states.back();
+
+		parse_material_implementation(source, context_impl, state);
+
+		for (auto& error : state.errors)
+			merged.errors.push_back("[material " + std::to_string(states.size() - 1) + "] " + error);
+	}
+
+	if (merged.errors.size() != 0)
+		return merged;
+
+	if (states.size() == 0)
+	{
+		merged.errors = { "[0] No materials to merge" };
+		return merged;
+	}
+
+	auto domain = states.front().domain;
+
+	for (auto& state : states)
+		if (state.domain != domain)
+		{
+			merged.errors = { "[0] Merged materials must use the same domain" };
+			return merged;
+		}
+
+	if (domain->parameters_layout != parameters_layout_type::buffer)
+	{
+		merged.errors = { "[0] Merged materials domain must dump parameters into a buffer, indexed by the material id" };
+		return merged;
+	}
+
+	if (translator->parameters_block_translator == nullptr ||
+		translator->variables_assignments_translator == nullptr ||
+		translator->variable_name_translator == nullptr ||
+		translator->material_switch_translator == nullptr)
+	{
+		merged.errors = { "[0] Target language does not support merging materials" };
+		return merged;
+	}
+
+	//variables, functions and textures declared by materials are emitted with names prefixed with the material id, so they does not collide
+	//variables collections keys are left as they are; functions are emitted by their name pointers, which are pointed to the prefixed names
+	//textures are not per material elements of the parameters buffer, so their records are renamed, and the nodes using them emit the prefixed names
+	std::vector<std::string> prefixes;
+	std::list<std::string> functions_names;
+
+	for (auto& state : states)
+	{
+		prefixes.push_back("m" + std::to_string(prefixes.size()) + "_");
+
+		for (auto& func : state.functions)
+		{
+			functions_names.push_back(prefixes.back() + func.first);
+			func.second.function_name_ptr = &functions_names.back();
+		}
+
+		for (auto param = state.parameters.begin(); param != state.parameters.end(); param++)
+			if (param->second.type == texture_data_type)
+				state.parameters.rename(param, prefixes.back() + param->first);
+	}
+
+	//numeric parameters of the same name are shared between the materials, each material has its own element of the parameters buffer
+	parameters_collection parameters;
+
+	for (auto& state : states)
+		for (auto& param : state.parameters)
+		{
+			auto itr = parameters.find(param.first);
+
+			if (itr == parameters.end())
+				parameters.insert({ param.first, param.second });
+			else if (itr->second.type != param.second.type)
+				merged.errors.push_back("[0] Parameter " + param.first + " has different types in merged materials");
+		}
+
+	if (merged.errors.size() != 0)
+		return merged;
+
+	merged.success = true;
+
+	auto parameters_block = get_parameters_block_layout(parameters, parameters_layout_type::buffer);
+
+	//variables reachability of every material, shared by its dump variables directives and its cost estimate
+	std::vector<variables_reachability> reachabilities(states.size());
+
+	size_t state_index = 0;
+	for (auto& state : states)
+		build_variables_reachability(state.variables, reachabilities.at(state_index++));
+
+	std::vector<expression*> dumped_values;
+	std::vector<uint64_t> dumped;
+	std::vector<uint32_t> uses;
+
+	//variables declared before the material switch are referred to by their prefixed names, instead of being inlined
+	inlined_variables inlined;
+	std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions;
+
+	auto get_material_id = [&]() -> std::string
+	{
+		auto index_symbol = domain->parameters_index_symbol;
+		return index_symbol->definitions.at(current_symbols_definitions.at(index_symbol));
+	};
+
+	auto dump_property = [&](const directive& directive)
+	{
+		std::vector<std::string> cases;
+
+		for (auto& state : states)
+		{
+			auto& property = state.properties.at(directive.payload.at(0));
+
+			cases.push_back(translator->expression_translator(
+				property.value,
+				&inlined,
+				property.value->used_functions.at(0),
+				current_symbols_definitions,
+				domain.get()
+			));
+		}
+
+		merged.sources.back() += '(';
+		merged.sources.back() += translator->material_switch_translator(get_material_id(), cases, true);
+		merged.sources.back() += ')';
+	};
+
+	auto dump_variables = [&](const directive& directive)
+	{
+		std::vector<std::string> cases;
+		bool any_assignment = false;
+
+		size_t material_index = 0;
+
+		for (auto& state : states)
+		{
+			auto& prefix = prefixes.at(material_index);
+			auto& reachability = reachabilities.at(material_index++);
+			auto& variables = reachability.variables;
+
+			dumped_values.clear();
+			for (auto& prop : directive.payload)
+				dumped_values.push_back(state.properties.at(prop).value);
+
+			get_dumped_variables(reachability, dumped_values, dumped, uses);
+
+			cases.push_back("");
+			auto& assignments = cases.back();
+
+			//variables indices follow their definition order
+			for (size_t index = 0; index < variables.size(); index++)
+			{
+				if (!is_variable_reachable(dumped, index)) continue;
+
+				auto& variable_name = variables[index]->first;
+				auto& variable = variables[index]->second;
+				auto& used_functions = variable.value->used_functions.at(0);
+
+				if (should_inline_variable(variables[index], uses[index]))
+				{
+					inlined.insert({
+						variables[index],
+						"(" + translator->expression_translator(variable.value, &inlined, used_functions, current_symbols_definitions, domain.get()) + ")"
+					});
+				}
+				else
+				{
+					auto prefixed_name = prefix + variable_name;
+
+					merged.sources.back() += translator->variables_assignments_translator(
+						prefixed_name, &variable, &inlined, used_functions, current_symbols_definitions, domain.get(), true);
+					assignments += translator->variables_assignments_translator(
+						prefixed_name, &variable, &inlined, used_functions, current_symbols_definitions, domain.get(), false);
+
+					inlined.insert({ variables[index], translator->variable_name_translator(prefixed_name) });
+				}
+			}
+
+			any_assignment |= assignments.size() != 0;
+		}
+
+		if (any_assignment)
+			merged.sources.back() += translator->material_switch_translator(get_material_id(), cases, false);
+	};
+
+	//function instances shared by materials (eg. from libraries) are dumped only once
+	auto dump_functions = [&](const directive& directive)
+	{
+		counting_set<function_instance*> functions;
+		std::unordered_set<const named_variable*> walked;
+
+		for (auto& state : states)
+			for (auto& prop : directive.payload)
+				get_used_functions_recursive(state.properties.at(prop).value, functions, walked);
+
+		for (auto func_itr = functions.begin(); func_itr != functions.end(); func_itr++)
+		{
+			if (func_itr->first->function->is_exposed) continue;
+			merged.sources.back() += translate_function_instance(func_itr->first, translator, current_symbols_definitions);
+		}
+	};
+
+	auto dump_parameters = [&]()
+	{
+		if (parameters_block.members.size() != 0)
+			merged.sources.back() += translator->parameters_block_translator(parameters_block, parameters_layout_type::buffer);
+
+		for (auto& parameter : parameters)
+			if (parameter.second.type == texture_data_type)
+				merged.sources.back() += translator->parameters_declarations_translator(parameter.first, &parameter.second);
+	};
+
+	emit_domain_directives(
+		*domain, context_impl, merged.sources, current_symbols_definitions,
+		dump_property, dump_variables, dump_functions, dump_parameters, []() {}
+	);
+
+	std::unordered_map<std::string, uint32_t> block_offsets;
+	for (size_t i = 0; i < parameters_block.members.size(); i++)
+		block_offsets.insert({ parameters_block.members.at(i)->first, parameters_block.offsets.at(i) });
+
+	merged.parameters_block_size = parameters_block.size;
+
+	cost_estimator estimator(context_impl);
+
+	uint32_t material_id = 0;
+	for (auto& state : states)
+	{
+		merged.materials.push_back({});
+		auto& material = merged.materials.back();
+
+		material.id = material_id++;
+
+		std::vector<expression*> properties;
+		for (auto& prop : state.properties)
+			properties.push_back(prop.second.value);
+
+		material.cost = estimator.estimate(properties, reachabilities.at(material.id)).weighted_cost;
+
+		for (auto& param : state.parameters)
+		{
+			material.parameters.push_back({});
+			auto& param_info = material.parameters.back();
+
+			auto offset_itr = block_offsets.find(param.first);
+			if (offset_itr != block_offsets.end())
+				param_info.block_offset = offset_itr->second;
+
+			get_parameter_info(param, param_info);
+		}
+
+		merged.coherent_cost = std::max(merged.coherent_cost, material.cost);
+		merged.divergent_cost += material.cost;
+	}
+
+	return merged;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+//marks the variables used by the expression, directly or through other variables, in the row
+inline void add_expression_reachability(const variables_reachability& reachability, const expression* exp, uint64_t* row)
+{
+	for (auto& var : exp->used_variables)
+	{
+		auto index = var->second.index;
+		uint64_t bit = uint64_t(1) << (index % 64);
+
+		//the variable's row is already included if it is marked
+		if (row[index / 64] & bit) continue;
+		row[index / 64] |= bit;
+
+		const uint64_t* var_row = reachability.rows.data() + index * reachability.words;
+		for (size_t word = 0; word < reachability.words; word++)
+			row[word] |= var_row[word];
+	}
+}
+
+//computes the rows of all material's variables
+inline void build_variables_reachability(variables_collection& variables, variables_reachability& reachability)
+{
+	reachability.words = (variables.size() + 63) / 64;
+	reachability.variables.clear();
+	reachability.rows.assign(variables.size() * reachability.words, 0);
+
+	//variables can only use variables definied before them, so rows they depend on are already complete
+	for (auto& var : variables)
+	{
+		reachability.variables.push_back(&var);
+
+		if (var.second.value != nullptr)
+			add_expression_reachability(reachability, var.second.value, reachability.rows.data() + var.second.index * reachability.words);
+	}
+}
+
+//returns the row of the property value, computed on the first call for given value
+inline const std::vector<uint64_t>& get_property_reachability(variables_reachability& reachability, const expression* value)
+{
+	auto itr = reachability.properties_rows.find(value);
+	if (itr != reachability.properties_rows.end())
+		return itr->second;
+
+	auto& row = reachability.properties_rows[value];
+	row.assign(reachability.words, 0);
+	add_expression_reachability(reachability, value, row.data());
+
+	return row;
+}
+
+//whether the variable of given index is marked in the row
+inline bool is_variable_reachable(const std::vector<uint64_t>& row, size_t index)
+{
+	return (row[index / 64] >> (index % 64)) & 1;
+}
+
+//marks the variables reachable from the values in dumped, and counts how many times each of them is used, by the values and by the other marked variables
+inline void get_dumped_variables(
+	variables_reachability& reachability,
+	const std::vector<expression*>& values,
+	std::vector<uint64_t>& dumped,
+	std::vector<uint32_t>& uses
+)
+{
+	auto& variables = reachability.variables;
+
+	dumped.assign(reachability.words, 0);
+	uses.assign(variables.size(), 0);
+
+	auto count_uses = [&](const expression* exp)
+	{
+		for (auto& var : exp->used_variables)
+			uses[var->second.index]++;
+	};
+
+	for (auto& value : values)
+	{
+		auto& row = get_property_reachability(reachability, value);
+
+		for (size_t word = 0; word < reachability.words; word++)
+			dumped[word] |= row[word];
+
+		count_uses(value);
+	}
+
+	for (size_t index = 0; index < variables.size(); index++)
+		if (is_variable_reachable(dumped, index))
+			count_uses(variables[index]->second.value);
+}
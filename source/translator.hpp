@@ -2,16 +2,20 @@
 
 struct translator;
 struct material_parsing_state;
+struct parsed_domain;
 
 std::unordered_map<std::string, translator*> translators;
 
 struct translator
 {
+	const std::string language_name;
+
 	using _expression_translator = std::string(*)(
 		const expression* const& exp,
 		const inlined_variables* inlined,
 		const std::vector<function_instance*>& functions_instances,
-		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions
+		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions,
+		const parsed_domain* domain
 	);
 	const _expression_translator expression_translator;
 
@@ -20,7 +24,8 @@ struct translator
 		const variable_definition* const& var,
 		const inlined_variables* inlined,
 		const std::vector<function_instance*>& functions_instances,
-		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions
+		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions,
+		const parsed_domain* domain
 	);
 	const _variables_declarations_translator variables_declarations_translator;
 
@@ -30,6 +35,41 @@ struct translator
 	);
 	_parameters_declarations_translator parameters_declarations_translator;
 
+	//optional; translates parameters packed into a single block, used when domain dumps parameters as a block or buffer
+	using _parameters_block_translator = std::string(*)(
+		const parameters_block_layout& layout,
+		parameters_layout_type type
+	);
+	_parameters_block_translator parameters_block_translator;
+
+	//optional; used when merging materials, where variables are declared before the material switch and assigned inside of it
+	//translates variable declaration without a value if declaration is true, or the assignment of the variable value otherwise
+	using _variables_assignments_translator = std::string(*)(
+		const string_view& name,
+		const variable_definition* const& var,
+		const inlined_variables* inlined,
+		const std::vector<function_instance*>& functions_instances,
+		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions,
+		const parsed_domain* domain,
+		bool declaration
+	);
+	_variables_assignments_translator variables_assignments_translator;
+
+	//optional; used when merging materials; translates the name the declared variable is referred to with in the expressions
+	using _variable_name_translator = std::string(*)(
+		const string_view& name
+	);
+	_variable_name_translator variable_name_translator;
+
+	//optional; used when merging materials; selects one of the cases depending on the material id
+	//if is_expression is true cases are expressions and the result must be an expression, otherwise cases are statements
+	using _material_switch_translator = std::string(*)(
+		const std::string& material_id,
+		const std::vector<std::string>& cases,
+		bool is_expression
+	);
+	_material_switch_translator material_switch_translator;
+
 	using _function_header_translator = std::string(*)(
 		const function_instance* instance
 	);
@@ -48,13 +88,22 @@ struct translator
 		_variables_declarations_translator		__variable_declaration_translator,
 		_parameters_declarations_translator		__parameters_declarations_translator,
 		_function_header_translator				__function_header_translator,
-		_function_return_statement_translator	__function_return_statement_translator
+		_function_return_statement_translator	__function_return_statement_translator,
+		_parameters_block_translator			__parameters_block_translator = nullptr,
+		_variables_assignments_translator		__variables_assignments_translator = nullptr,
+		_material_switch_translator				__material_switch_translator = nullptr,
+		_variable_name_translator				__variable_name_translator = nullptr
 	) :
+		language_name(_language_name),
 		expression_translator(__expression_translator),
 		variables_declarations_translator(__variable_declaration_translator),
 		function_header_translator(__function_header_translator),
 		function_return_statement_translator(__function_return_statement_translator),
-		parameters_declarations_translator(__parameters_declarations_translator)
+		parameters_declarations_translator(__parameters_declarations_translator),
+		parameters_block_translator(__parameters_block_translator),
+		variables_assignments_translator(__variables_assignments_translator),
+		variable_name_translator(__variable_name_translator),
+		material_switch_translator(__material_switch_translator)
 	{
 		translators.insert({ _language_name, this });
 	};
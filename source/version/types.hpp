@@ -1,45 +1,43 @@
 #pragma once
 
+//id, name, vector size; ids must be the types indexes
 const std::vector<data_type> data_types
 {
-	{ "bool", },
-	{ "scalar", },
-	{ "vector2", },
-	{ "vector3", },
-	{ "vector4", },
-	{ "texture", }
+	{ 0, "bool", 0 },
+	{ 1, "scalar", 1 },
+	{ 2, "vector2", 2 },
+	{ 3, "vector3", 3 },
+	{ 4, "vector4", 4 },
+	{ 5, "texture", 0 }
 };
 
-inline bool is_vector(const data_type* type)
+inline size_t get_data_types_count()
 {
-	if (type == get_data_type({ "vector2" })) return true;
-	if (type == get_data_type({ "vector3" })) return true;
-	if (type == get_data_type({ "vector4" })) return true;
+	return data_types.size();
+}
 
-	return false;
+inline bool is_vector(const data_type* type)
+{
+	return type != nullptr && type->vector_size > 1;
 }
 
 inline uint8_t get_vector_size(const data_type* type)
 {
-	if (type == get_data_type({ "scalar" })) return 1;
-	if (type == get_data_type({ "vector2" })) return 2;
-	if (type == get_data_type({ "vector3" })) return 3;
-	if (type == get_data_type({ "vector4" })) return 4;
-
-	return 0;
+	return type != nullptr ? type->vector_size : 0;
 }
 
 inline const data_type* get_vector_type_of_size(uint8_t size)
 {
-	switch (size)
-	{
-	case 1: return get_data_type({ "scalar" });
-	case 2: return get_data_type({ "vector2" });
-	case 3: return get_data_type({ "vector3" });
-	case 4: return get_data_type({ "vector4" });
-	}
-
-	return nullptr;
+	static const data_type* const vector_types[] = {
+		nullptr,
+		get_data_type({ "scalar" }),
+		get_data_type({ "vector2" }),
+		get_data_type({ "vector3" }),
+		get_data_type({ "vector4" })
+	};
+
+	if (size > 4) return nullptr;
+	return vector_types[size];
 }
 
 inline const data_type* const get_data_type(const string_view& name)
@@ -0,0 +1,112 @@
+//Variables and functions that form diamond shaped graphs (every level uses the previous one twice)
+//must be walked once per node, not once per path; 30 levels would take 2^30 steps otherwise
+
+#define MATL_IMPLEMENTATION
+#include "matl.hpp"
+#include "translators/matl_glsl.hpp"
+
+#include <chrono>
+#include <iostream>
+
+const std::string domain_source = R"(<expose>
+    <property   scalar    value>
+    <symbol scalar x = in_x>
+<end>
+<dump parameters>
+<dump functions>
+    <property value>
+<end>
+void main()
+{
+    <dump variables>
+        <property value>
+    <end>
+    out_value = <property value>;
+}
+)";
+
+const int levels = 30;
+
+//levels of functions calling the previous one twice, and levels of variables using the previous one twice
+std::string get_diamond_material()
+{
+	std::string source = "using domain test\n";
+
+	source += "func f0(x)\n\treturn x * 2\n";
+	for (int i = 1; i <= levels; i++)
+	{
+		auto previous = "f" + std::to_string(i - 1);
+		source += "func f" + std::to_string(i) + "(x)\n\treturn " + previous + "(x) + " + previous + "(x * 2)\n";
+	}
+
+	source += "let a0 = f" + std::to_string(levels) + "(domain.x)\n";
+	for (int i = 1; i <= levels; i++)
+	{
+		auto level = std::to_string(i);
+		auto previous = "a" + std::to_string(i - 1);
+		source += "let b" + level + " = " + previous + " * 2\n";
+		source += "let c" + level + " = " + previous + " * 3\n";
+		source += "let a" + level + " = b" + level + " + c" + level + "\n";
+	}
+
+	source += "property value = a" + std::to_string(levels) + "\n";
+	return source;
+}
+
+int main()
+{
+	auto context = matl::create_context("opengl_glsl");
+
+	auto domain_raport = matl::parse_domain("test", domain_source, context);
+	if (!domain_raport.success)
+	{
+		std::cout << "Domain parsing failed\n";
+		return 1;
+	}
+
+	auto material_source = get_diamond_material();
+
+	auto begin = std::chrono::steady_clock::now();
+	auto material = matl::parse_material(material_source, context);
+	auto end = std::chrono::steady_clock::now();
+
+	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+	std::cout << levels << " levels diamond parsed in " << milliseconds << " ms\n";
+
+	int failures = 0;
+
+	if (!material.success)
+	{
+		for (auto& error : material.errors)
+			std::cout << "Error: " << error << "\n";
+		failures++;
+	}
+
+	//every function is dumped exactly once
+	if (material.success)
+		for (int i = 0; i <= levels; i++)
+		{
+			auto header = "_matl_f_f" + std::to_string(i) + "(";
+			auto& source = material.sources.front();
+
+			size_t definitions = 0;
+			for (size_t position = source.find("float " + header); position != std::string::npos; position = source.find("float " + header, position + 1))
+				definitions++;
+
+			if (definitions != 1)
+			{
+				std::cout << "Function f" << i << " dumped " << definitions << " times\n";
+				failures++;
+			}
+		}
+
+	//linear walk takes well under a millisecond per level, exponential one takes minutes; the bound leaves room for debug and sanitized builds
+	if (milliseconds > 2000)
+	{
+		std::cout << "Parsing took too long\n";
+		failures++;
+	}
+
+	matl::destroy_context(context);
+	return failures == 0 ? 0 : 1;
+}
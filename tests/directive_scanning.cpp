@@ -0,0 +1,139 @@
+//Vectorized scan for domain directives must give the same results as the plain loop it replaced
+//random sources are scanned by both, then the scan speed is reported on a large domain-like source
+
+#define MATL_IMPLEMENTATION
+#include "matl.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+//the loop used before the vectorized scan
+void reference_get_to_char_while_counting_lines(char target, const source_view& source, size_t& iterator, int& line_counter, bool& whitespaces_only)
+{
+	whitespaces_only = true;
+
+	while (source.at(iterator) != target)
+	{
+		if (source.at(iterator) == '\n') line_counter++;
+		else if (!is_whitespace(source.at(iterator))) whitespaces_only = false;
+
+		iterator++;
+		if (is_at_source_end(source, iterator))
+			return;
+	}
+}
+
+int test_equivalence()
+{
+	std::mt19937 random(12345);
+
+	//mostly whitespaces, so whitespace only blocks and long scans both happen
+	const char alphabet[] = { ' ', ' ', ' ', '\t', '\n', '\n', 'a', 'x', '<', '>', '\0' };
+	const size_t alphabet_size = sizeof(alphabet);
+
+	int failures = 0;
+
+	for (int test = 0; test < 20000; test++)
+	{
+		size_t size = 1 + random() % 200;
+		bool with_zeros = test % 4 == 0;
+
+		std::string source(size, ' ');
+		for (auto& c : source)
+			c = alphabet[random() % (with_zeros ? alphabet_size : alphabet_size - 1)];
+
+		//most sources have no directives at all, like long glsl blocks
+		if (test % 3 == 0)
+			for (auto& c : source)
+				if (c == '<' || c == '>') c = ' ';
+
+		char target = test % 2 == 0 ? '<' : '>';
+		size_t begin = random() % size;
+
+		size_t iterator = begin, reference_iterator = begin;
+		int lines = 0, reference_lines = 0;
+		bool whitespaces_only = false, reference_whitespaces_only = false;
+
+		get_to_char_while_counting_lines(target, source, iterator, lines, whitespaces_only);
+		reference_get_to_char_while_counting_lines(target, source, reference_iterator, reference_lines, reference_whitespaces_only);
+
+		if (iterator != reference_iterator || lines != reference_lines || whitespaces_only != reference_whitespaces_only)
+		{
+			if (failures++ < 10)
+				std::cout << "Mismatch at test " << test << ": iterator " << iterator << " / " << reference_iterator
+				<< ", lines " << lines << " / " << reference_lines
+				<< ", whitespaces only " << whitespaces_only << " / " << reference_whitespaces_only << "\n";
+		}
+	}
+
+	return failures;
+}
+
+//time of scanning the whole source for directives, best of few runs
+template<class _scan>
+double get_scan_time(const std::string& source, _scan scan, int& lines)
+{
+	double best = 0;
+
+	for (int run = 0; run < 5; run++)
+	{
+		lines = 0;
+		size_t iterator = 0;
+		bool whitespaces_only = false;
+
+		auto begin = std::chrono::steady_clock::now();
+		while (!is_at_source_end(source, iterator))
+		{
+			scan('<', source, iterator, lines, whitespaces_only);
+			if (!is_at_source_end(source, iterator)) iterator++;
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		double time = std::chrono::duration<double, std::micro>(end - begin).count();
+		if (run == 0 || time < best) best = time;
+	}
+
+	return best;
+}
+
+int benchmark()
+{
+	//glsl blocks with a directive every ~4 KB
+	const std::string glsl_line = "    vec3 light = normalize(light_position - fragment_position) * intensity;\n";
+
+	std::string source;
+	while (source.size() < 200 * 1024)
+	{
+		for (int i = 0; i < 50; i++) source += glsl_line;
+		source += "<property color>\n";
+	}
+
+	int lines = 0, reference_lines = 0;
+	double time = get_scan_time(source, get_to_char_while_counting_lines, lines);
+	double reference_time = get_scan_time(source, reference_get_to_char_while_counting_lines, reference_lines);
+
+#ifdef MATL_SSE2
+	const char* variant = "SSE2";
+#else
+	const char* variant = "scalar";
+#endif
+
+	std::cout << "Scanned " << source.size() / 1024 << " KB: " << variant << " " << time << " us, reference loop " << reference_time << " us\n";
+
+	if (lines != reference_lines)
+	{
+		std::cout << "Lines counts differ: " << lines << " / " << reference_lines << "\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+int main()
+{
+	int failures = test_equivalence();
+	failures += benchmark();
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+//Parsing time of an expression must grow linearly with its nesting depth
+//every level opens a function call and a parenthesis, so parser that rescans the parentheses to count the arguments is quadratic
+
+#define MATL_IMPLEMENTATION
+#include "matl.hpp"
+#include "translators/matl_glsl.hpp"
+
+#include <chrono>
+#include <iostream>
+
+const std::string domain_source = R"(<expose>
+    <property   scalar    value>
+    <symbol scalar x = in_x>
+<end>
+<dump functions>
+    <property value>
+<end>
+void main()
+{
+    <dump variables>
+        <property value>
+    <end>
+    out_value = <property value>;
+}
+)";
+
+//g(1, (g(1, (... v ...))))
+std::string get_nested_material(int depth)
+{
+	std::string source = "using domain test\nfunc g(a, b)\n\treturn a + b\nlet v = domain.x\nproperty value = ";
+
+	for (int i = 0; i < depth; i++)
+		source += "g(1, (";
+
+	source += "v";
+
+	for (int i = 0; i < depth; i++)
+		source += "))";
+
+	source += "\n";
+	return source;
+}
+
+//best of few runs, so the scheduler noise does not decide the result
+double get_parsing_time(const std::string& source, matl::context* context, bool& success)
+{
+	double best = 0;
+
+	for (int run = 0; run < 9; run++)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		auto material = matl::check_material(source, context);
+		auto end = std::chrono::steady_clock::now();
+
+		success = material.success;
+		if (!success)
+		{
+			for (auto& error : material.errors)
+				std::cout << "Error: " << error << "\n";
+			return 0;
+		}
+
+		double time = std::chrono::duration<double, std::micro>(end - begin).count();
+		if (run == 0 || time < best) best = time;
+	}
+
+	return best;
+}
+
+int main()
+{
+	auto context = matl::create_context("opengl_glsl");
+
+	auto domain_raport = matl::parse_domain("test", domain_source, context);
+	if (!domain_raport.success)
+	{
+		std::cout << "Domain parsing failed\n";
+		return 1;
+	}
+
+	const int depth = 250;
+	const int scale = 4;
+
+	bool success = false;
+	double single_time = get_parsing_time(get_nested_material(depth), context, success);
+	if (!success) return 1;
+
+	double scaled_time = get_parsing_time(get_nested_material(depth * scale), context, success);
+	if (!success) return 1;
+
+	double ratio = scaled_time / single_time;
+	std::cout << "depth " << depth << ": " << single_time << " us, depth " << depth * scale << ": " << scaled_time << " us, ratio " << ratio << "\n";
+
+	matl::destroy_context(context);
+
+	//linear parsing gives ratio of ~4, quadratic one ~16
+	if (ratio > 8)
+	{
+		std::cout << "Parsing time does not scale linearly with the nesting depth\n";
+		return 1;
+	}
+
+	return 0;
+}
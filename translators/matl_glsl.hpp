@@ -10,41 +10,54 @@
 
 namespace matl_glsl
 {
-	inline std::string variable_name_formater(const string_ref& name)
+	inline std::string variable_name_formater(const string_view& name)
 	{
 		return "_matl_v_" + std::string(name);
 	}
 
-	inline std::string parameter_name_formater(const string_ref& name)
+	inline std::string parameter_name_formater(const string_view& name)
 	{
 		return "_matl_p_" + std::string(name);
 	}
 
+	inline std::string parameter_access_formater(
+		const named_parameter* param, 
+		const parsed_domain* domain, 
+		const std::unordered_map<const symbol_definition*, size_t>& current_symbols_definitions
+	)
+	{
+		if (domain == nullptr || domain->parameters_layout != parameters_layout_type::buffer || param->second.type == texture_data_type)
+			return parameter_name_formater(param->first);
+
+		auto& index = domain->parameters_index_symbol->definitions.at(current_symbols_definitions.at(domain->parameters_index_symbol));
+		return "_matl_parameters[int(" + std::string(index) + ")]." + parameter_name_formater(param->first);
+	}
+
 	inline std::string function_name_formater(const std::string& name)
 	{
 		return "_matl_f_" + name;
 	}
 
-	inline std::string function_from_lib_name_formater(const string_ref& library_name, const string_ref& name)
+	inline std::string function_from_lib_name_formater(const string_view& library_name, const string_view& name)
 	{
 		return "_matl_lf_" + std::string(library_name) +  "_" + std::string(name);
 	}
 
 	inline const char* translate_type_name(const data_type* type)
 	{
-		if (type->name == "bool")
-			return "bool";
-		if (type->name == "scalar")
-			return "float";
-		if (type->name == "vector2")
-			return "vec2";
-		if (type->name == "vector3")
-			return "vec3";
-		if (type->name == "vector4")
-			return "vec4";
-		if (type->name == "texture")
-			return "sampler2D";
-		return "invalid";
+		//indexed by data_type::id; see source/version/types.hpp
+		static const char* const types_names[] = {
+			"bool",
+			"float",
+			"vec2",
+			"vec3",
+			"vec4",
+			"sampler2D"
+		};
+
+		if (type->id >= sizeof(types_names) / sizeof(types_names[0]))
+			return "invalid";
+		return types_names[type->id];
 	}
 
 	inline const char* translate_unary_operator(const unary_operator_definition* operato)
@@ -69,7 +82,8 @@ namespace matl_glsl
 		const expression::single_expression* const& le,
 		const inlined_variables* inlined,
 		const std::vector<function_instance*>& functions_instances,
-		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions
+		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions,
+		const parsed_domain* domain
 	)
 	{
 		size_t functions_instances_iterator = 0;
@@ -163,7 +177,7 @@ namespace matl_glsl
 			if (func->second.is_exposed)
 				base += functions_instances.at(functions_instances_iterator)->function_native_name;
 			else if (func->second.library == nullptr)
-				base += function_name_formater(func->first);
+				base += function_name_formater(*func->second.function_name_ptr);
 			else
 				base += function_from_lib_name_formater(
 					func->second.library->first,
@@ -214,7 +228,7 @@ namespace matl_glsl
 			case node::node_type::symbol:
 				values.push_back({ 0, node->as_symbol()->definitions.at(current_symbols_definitions.at(node->as_symbol()))}); break;
 			case node::node_type::parameter:
-				values.push_back({ 0, parameter_name_formater(node->as_parameter()->first)}); break;
+				values.push_back({ 0, parameter_access_formater(node->as_parameter(), domain, current_symbols_definitions)}); break;
 			case node::node_type::scalar_literal:
 				push_scalar(node->as_scalar_literal()); break;
 			case node::node_type::binary_operator:
@@ -238,31 +252,32 @@ namespace matl_glsl
 		const expression* const& exp,
 		const inlined_variables* inlined,
 		const std::vector<function_instance*>& functions_instances,
-		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions
+		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions,
+		const parsed_domain* domain
 	)
 	{
 		std::string result;
 
-		if (exp->equations.size() == 1)
+		if (exp->cases.size() == 1)
 		{
-			result += translate_single_expression(exp->equations.front()->value, inlined, functions_instances, current_symbols_definitions);
+			result += translate_single_expression(exp->cases.front()->value, inlined, functions_instances, current_symbols_definitions, domain);
 			return result;
 		}
 
 		int counter = 0;
-		for (auto& equation : exp->equations)
+		for (auto& equation : exp->cases)
 		{
 			if (equation->condition == nullptr)
 			{
-				result += translate_single_expression(equation->value, inlined, functions_instances, current_symbols_definitions);
+				result += translate_single_expression(equation->value, inlined, functions_instances, current_symbols_definitions, domain);
 				result.reserve(result.size() + counter);
 				while (counter != 0) { result += ')'; counter--; }
 				break;
 			}
 
-			result += translate_single_expression(equation->condition, inlined, functions_instances, current_symbols_definitions);
+			result += translate_single_expression(equation->condition, inlined, functions_instances, current_symbols_definitions, domain);
 			result += "?(";
-			result += translate_single_expression(equation->value, inlined, functions_instances, current_symbols_definitions);
+			result += translate_single_expression(equation->value, inlined, functions_instances, current_symbols_definitions, domain);
 			result += "):(";
 
 			counter++;
@@ -272,11 +287,12 @@ namespace matl_glsl
 	}
 
 	std::string translate_variable(
-		const string_ref& name,
+		const string_view& name,
 		const variable_definition* const& var,
 		const inlined_variables* inlined,
 		const std::vector<function_instance*>& functions_instances,
-		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions
+		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions,
+		const parsed_domain* domain
 	)
 	{
 		std::string result;
@@ -286,14 +302,86 @@ namespace matl_glsl
 		result += " ";
 		result += variable_name_formater(name);
 		result += " = ";
-		result += translate_expression(var->definition, inlined, functions_instances, current_symbols_definitions);
+		result += translate_expression(var->value, inlined, functions_instances, current_symbols_definitions, domain);
 		result += ";\n";
 
 		return result;
 	}
 
+	std::string translate_variable_assignment(
+		const string_view& name,
+		const variable_definition* const& var,
+		const inlined_variables* inlined,
+		const std::vector<function_instance*>& functions_instances,
+		const std::unordered_map<const symbol_definition*, size_t> current_symbols_definitions,
+		const parsed_domain* domain,
+		bool declaration
+	)
+	{
+		std::string result;
+		result.reserve(64);
+
+		if (declaration)
+		{
+			result += translate_type_name(var->type);
+			result += " ";
+			result += variable_name_formater(name);
+			result += ";\n";
+			return result;
+		}
+
+		result += variable_name_formater(name);
+		result += " = ";
+		result += translate_expression(var->value, inlined, functions_instances, current_symbols_definitions, domain);
+		result += ";\n";
+
+		return result;
+	}
+
+	std::string translate_material_switch(
+		const std::string& material_id,
+		const std::vector<std::string>& cases,
+		bool is_expression
+	)
+	{
+		std::string result;
+
+		if (is_expression)
+		{
+			for (size_t i = 0; i < cases.size(); i++)
+			{
+				if (i != cases.size() - 1)
+					result += "int(" + material_id + ")==" + std::to_string(i) + "?";
+
+				result += '(';
+				result += cases.at(i);
+				result += ')';
+
+				if (i != cases.size() - 1)
+					result += ':';
+			}
+
+			return result;
+		}
+
+		result += "switch (int(" + material_id + "))\n{\n";
+
+		for (size_t i = 0; i < cases.size(); i++)
+		{
+			if (cases.at(i).size() == 0) continue;
+
+			result += "case " + std::to_string(i) + ":\n";
+			result += cases.at(i);
+			result += "break;\n";
+		}
+
+		result += "}\n";
+
+		return result;
+	}
+
 	std::string translate_parameter_opengl(
-		const string_ref& name,
+		const string_view& name,
 		const parameter_definition* const& param
 	)
 	{
@@ -309,6 +397,33 @@ namespace matl_glsl
 		return result;
 	}
 
+	std::string translate_parameters_block_opengl(const parameters_block_layout& layout, parameters_layout_type type)
+	{
+		std::string result;
+		result.reserve(128 + layout.members.size() * 32);
+
+		if (type == parameters_layout_type::buffer)
+			result += "struct _matl_parameters_t\n{\n";
+		else
+			result += "layout(std140) uniform _matl_parameters\n{\n";
+
+		for (auto& param : layout.members)
+		{
+			result += '\t';
+			result += translate_type_name(param->second.type);
+			result += " ";
+			result += parameter_name_formater(param->first);
+			result += ";\n";
+		}
+
+		result += "};\n";
+
+		if (type == parameters_layout_type::buffer)
+			result += "layout(std430) readonly buffer _matl_parameters_buffer\n{\n\t_matl_parameters_t _matl_parameters[];\n};\n";
+
+		return result;
+	}
+
 	std::string translate_function_header(const function_instance* instance)
 	{
 		std::string result;
@@ -348,7 +463,7 @@ namespace matl_glsl
 		result.reserve(128);
 
 		result += "\treturn ";
-		result += translate_expression(instance->function->returned_value, &inlined, used_instances, {});
+		result += translate_expression(instance->function->returned_value, &inlined, used_instances, {}, nullptr);
 		result += ";\n";
 
 		result += "};\n";
@@ -356,6 +471,7 @@ namespace matl_glsl
 		return result;
 	}
 
-	::translator translator{"opengl_glsl", translate_expression, translate_variable, translate_parameter_opengl, translate_function_header, translate_function_return};
+	::translator translator{"opengl_glsl", translate_expression, translate_variable, translate_parameter_opengl, translate_function_header, translate_function_return, translate_parameters_block_opengl,
+		translate_variable_assignment, translate_material_switch, variable_name_formater};
 };
 #endif
\ No newline at end of file